@@ -17,12 +17,116 @@ typedef struct parameters_setting {
         unsigned int delta;             /**< Interval of sampling */
 } parameters_setting_t;
 
+/** Filters turning m pulse widths into one result */
+enum hcsr_filter_type {
+        HCSR_FILTER_AVERAGE,                    /**< Drop min and max, average the rest */
+        HCSR_FILTER_MEDIAN,                     /**< Median of m */
+        HCSR_FILTER_TRIMMED,                    /**< Drop trim at each end, average the rest */
+        HCSR_FILTER_TRACKER,                    /**< Alpha-beta tracker over the medians */
+        HCSR_FILTER_MAX,
+};
+
+#define HCSR_FILTER_ONE (1024)                  /**< Fixed point 1.0 of the tracker gains */
+
+typedef struct filter_setting {
+        unsigned int type;                      /**< enum hcsr_filter_type */
+        unsigned int trim;                      /**< Samples dropped at each end (trimmed) */
+        unsigned int alpha;                     /**< Position gain (tracker), of HCSR_FILTER_ONE */
+        unsigned int beta;                      /**< Velocity gain (tracker), of HCSR_FILTER_ONE */
+} filter_setting_t;
+
+typedef struct eventfd_setting {
+        int fd;                                 /**< eventfd to signal, -1 to unbind */
+        unsigned int every;                     /**< Signal on every Nth result */
+} eventfd_setting_t;
+
+/** Zones of the threshold events, a result is in exactly one of them */
+enum hcsr_zone {
+        HCSR_ZONE_MIDDLE,                       /**< Between near and far, or no limit set */
+        HCSR_ZONE_NEAR,                         /**< Closer than near */
+        HCSR_ZONE_FAR,                          /**< Further than far */
+};
+
+typedef struct threshold_setting {
+        unsigned int near;                      /**< Near limit in mm, 0 off */
+        unsigned int far;                       /**< Far limit in mm, 0 off */
+        unsigned int hysteresis;                /**< Distance past a limit to leave its zone, mm */
+        unsigned int debounce;                  /**< Consecutive results to change zone */
+} threshold_setting_t;
+
 #define CONFIG_PINS _IOWR('d', 1, pins_setting_t *)
 #define SET_PARAMETERS _IOW('d', 2, parameters_setting_t *)
+#define SET_WATERMARK _IOW('d', 3, unsigned int *)
+#define SET_FILTER _IOW('d', 4, filter_setting_t *)
+#define SET_EVENTFD _IOW('d', 7, eventfd_setting_t *)
+#define SET_MAX_AGE _IOW('d', 8, unsigned int *)
+#define SET_THRESHOLD _IOW('d', 9, threshold_setting_t *)
 
 typedef struct result_info {
-        unsigned long long measurement;         /**< Distance measurement */
+        unsigned long long measurement;         /**< Distance measurement in mm */
         unsigned long long timestamp;           /**< Time stamp (x86 TSC) */
+        unsigned long long variance;            /**< Variance of the echoes in mm^2 */
+        unsigned int samples;                   /**< Triggers used for the result */
+        unsigned int reserved;                  /**< Keeps the size the same on x86_64 */
 } result_info_t;
 
+typedef struct threshold_event {
+        unsigned int zone;                      /**< Zone entered, enum hcsr_zone */
+        unsigned int from;                      /**< Zone left, enum hcsr_zone */
+        result_info_t result;                   /**< Result completing the crossing */
+} threshold_event_t;
+
+#define GET_EVENT _IOR('d', 10, threshold_event_t *)
+
+/** Records of an edge trace, see debugfs <device>/trace */
+enum hcsr_trace_kind {
+        HCSR_TRACE_ROUND,                       /**< A round starts, value is its number */
+        HCSR_TRACE_TRIGGER,                     /**< Trigger sent, value counts from 1 */
+        HCSR_TRACE_EDGE,                        /**< Echo edge, value is the level after it */
+        HCSR_TRACE_RESULT,                      /**< Round done, value is the result in mm */
+};
+
+typedef struct hcsr_trace_rec {
+        unsigned long long tsc;                 /**< Time stamp (x86 TSC) */
+        unsigned int kind;                      /**< enum hcsr_trace_kind */
+        unsigned int value;                     /**< Meaning depends on the kind */
+} hcsr_trace_rec_t;
+
+#define HCSR_MAX_SENSORS (10)                   /**< Sensors in one snapshot */
+#define HCSR_NAME_LEN   (16)                    /**< Device name length */
+
+typedef struct sensor_result {
+        char name[HCSR_NAME_LEN];               /**< Device name */
+        result_info_t result;                   /**< Latest result, timestamp 0 if none yet */
+} sensor_result_t;
+
+/** Latest result of every registered sensor, read from the control node */
+typedef struct hcsr_snapshot {
+        unsigned int count;                     /**< Sensors filled in */
+        sensor_result_t sensors[HCSR_MAX_SENSORS];
+} hcsr_snapshot_t;
+
+#define GET_SNAPSHOT _IOR('d', 5, hcsr_snapshot_t *)
+#define TRIGGER_ALL _IO('d', 6)
+#define ACK_MMAP _IOW('d', 11, unsigned int *)
+
+#define HCSR_MMAP_SLOTS (64)                    /**< Result slots in the shared ring */
+#define HCSR_MMAP_HDR   (4096)                  /**< Header size, slots start after it */
+
+/**
+ * Header page of the mmap'd result ring, followed by HCSR_MMAP_SLOTS
+ * result_info_t slots. Result i lives in slot (i & (slots - 1)).
+ * To read result i (head - slots < i < head) without tearing, checking
+ * the range against head inside the loop:
+ *   do { s = seq; check i; copy slot; } while ((s & 1) || s != seq);
+ * poll reports POLLIN while head differs from the index last passed to
+ * ACK_MMAP on that file, the index of the next result the reader wants.
+ */
+typedef struct hcsr_mmap_header {
+        volatile unsigned int head;             /**< Producer index, results published */
+        volatile unsigned int seq;              /**< Odd while a slot is being written */
+        unsigned int slots;                     /**< Number of slots, power of two */
+        unsigned int offset;                    /**< Offset of the first slot */
+} hcsr_mmap_header_t;
+
 #endif
\ No newline at end of file
@@ -8,20 +8,34 @@
 #define __HCSR_H__
 
 #include <linux/miscdevice.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/seqlock.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 
 #include "hcsr04.h"
 #include "ring_buff.h"
+#include "hcsr_filter.h"
+#include "hcsr_debugfs.h"
 
 #include "common.h"
 
 #define BUFF_SIZE       (16)                    /**< Name buffer size */
 #define NUM_OF_OUTLIER  (2)                     /**< Outliers we are going to remove */
 #define MIN_INTERVAL    (60)                    /**< Minimal sampling interval in ms */
+#define HISTORY_SIZE    (5)                     /**< Sampling history size */
+#define MAX_RANGE       (400)                   /**< Farthest echo waited for in cm */
+#define MAX_GUARD       (MIN_INTERVAL * 1000)   /**< Longest guard time in us */
+#define MAX_AGE         (60 * 1000)             /**< Oldest cached result in ms */
 
 
 typedef struct sample_data {
-        unsigned int count;                     /**< Number of samples */
-        unsigned long long *data;               /**< Sampling data storage */
+        unsigned int count;                     /**< Number of edges */
+        unsigned long long trigger;             /**< Time stamp of the latest trigger */
+        unsigned long long rise;                /**< Time stamp of the pending rising edge */
+        unsigned long long fall;                /**< Time stamp of the latest falling edge */
+        sample_stats_t stats;                   /**< Running aggregate of the widths */
 } sample_data_t;
 
 struct hcsr04_sysfs {
@@ -29,6 +43,14 @@ struct hcsr04_sysfs {
         parameters_setting_t params;            /**< Device parameters */
         pins_setting_t pins;                    /**< Device pin settings */
         int endless;                            /**< Nonstop measurement */
+        unsigned int watermark;                 /**< Results queued before waking readers */
+        int adaptive;                           /**< Trigger again once the echo is done */
+        unsigned int max_range;                 /**< Echo timeout as a distance in cm */
+        unsigned int guard;                     /**< Quiet time after an echo in us */
+        unsigned int rate;                      /**< Triggers per 1000s of the last round */
+        int temperature;                        /**< Ambient temperature in C */
+        unsigned int mm_mult;                   /**< Echo width to mm at that temperature */
+        unsigned int tolerance;                 /**< Stop a round early at this 95% interval in mm, 0 off */
 };
 
 typedef void(*cb_func)(unsigned long);
@@ -38,6 +60,38 @@ struct hcsr_cb {
         cb_func notify;                         /**< Call back function to notify the result */
 };
 
+struct hcsr_eventfd {
+        spinlock_t lock;                        /**< Binding changes while sampling */
+        struct eventfd_ctx *ctx;                /**< Bound eventfd, NULL if none */
+        struct file *owner;                     /**< File that bound it */
+        unsigned int every;                     /**< Signal on every Nth result */
+        unsigned int count;                     /**< Results since the last signal */
+};
+
+struct hcsr_thresh {
+        spinlock_t lock;                        /**< Setting changes while sampling */
+        threshold_setting_t setting;            /**< Limits, hysteresis and debounce */
+        unsigned int zone;                      /**< Zone of the last accepted result */
+        unsigned int pending;                   /**< Zone being debounced */
+        unsigned int count;                     /**< Results in the pending zone so far */
+        rec_ring_buff_t *events;                /**< Crossings not read yet */
+        struct mutex events_lock;               /**< Serialize event readers */
+        wait_queue_head_t wq;                   /**< Waiters for a crossing */
+};
+
+struct hcsr_replay;
+
+struct hcsr_trace {
+        u32 enabled;                            /**< Capture on, set through debugfs */
+        spinlock_t lock;                        /**< Serialize the isr and the thread */
+        rec_ring_buff_t *records;               /**< Captured records not read yet, NULL until enabled */
+        struct mutex read_lock;                 /**< Serialize trace readers and the allocation */
+        struct hcsr_replay *replay;             /**< Replay state, NULL until written */
+        struct mutex replay_lock;               /**< Serialize replay writers and readers */
+};
+
+struct iio_dev;
+
 /** per device structure */
 struct hcsr_dev {
         struct miscdevice miscdev;              /**< The miscdevice structure */
@@ -45,11 +99,35 @@ struct hcsr_dev {
         struct hcsr04_sysfs settings;           /**< Sysfs settings */
         struct hcsr_cb on_complete;             /**< Call back function on complete */
         int irq_no;                             /**< IRQ number for device */
-        mp_ring_buff_t *result_queue;           /**< FIFO result_queue queue */
+        rec_ring_buff_t *result_queue;          /**< FIFO result_queue queue */
+        struct mutex queue_lock;                /**< Serialize result_queue readers */
+        wait_queue_head_t result_wq;            /**< Readers waiting for results */
+        hcsr_mmap_header_t *shared;             /**< mmap'd result ring */
+        wait_queue_head_t mmap_wq;              /**< Pollers of the mmap'd ring */
+        wait_queue_head_t echo_wq;              /**< Sampling thread waiting for an echo */
+        struct hcsr_eventfd eventfd;            /**< eventfd signaled on results */
+        struct hcsr_thresh thresh;              /**< Threshold events */
+        struct hcsr_trace trace;                /**< Edge trace capture and replay */
         sample_data_t sample_result;            /**< Storage for sample result */
+        result_info_t latest;                   /**< Latest result, for the snapshot */
+        seqcount_t latest_seq;                  /**< Guards latest against torn reads */
+        unsigned int rounds;                    /**< Rounds completed, the request in flight is rounds + 1 */
+        struct list_head list;                  /**< Entry in the device registry */
+        hcsr_filter_t filter;                   /**< Filter applied to sample result */
+        hcsr_perf_t perf;                       /**< Latency and throughput statistics */
+        struct iio_dev *indio_dev;              /**< IIO front-end, NULL if none */
         atomic_t available;                     /**< Device singlton variable */
+        atomic_t pending;                       /**< A request found the round ending */
         struct task_struct *tsk;                /**< Sampling thread */
         int job_done;                           /**< Thread job flag */
 };
 
+/** per open file structure */
+typedef struct hcsr_file {
+        hcsr_dev_t *devp;                       /**< The device opened */
+        int mapped;                             /**< Shared ring mapped on this file */
+        unsigned int mmap_acked;                /**< Next shared ring result the reader wants */
+        unsigned int max_age;                   /**< read() takes a cached result this young in ms, 0 off */
+} hcsr_file_t;
+
 #endif
\ No newline at end of file
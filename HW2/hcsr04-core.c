@@ -16,6 +16,7 @@
 #include <linux/slab.h>
 #include <linux/init.h>
 #include <linux/fs.h>
+#include <linux/poll.h>
 
 #include <asm/div64.h>
 
@@ -26,6 +27,13 @@
 #include "hcsr_drv.h"
 #include "hcsr_config.h"
 #include "hcsr_sysfs.h"
+#include "hcsr_mmap.h"
+#include "hcsr_sim.h"
+#include "hcsr_debugfs.h"
+#include "hcsr_ctl.h"
+#include "hcsr_conv.h"
+#include "hcsr_iio.h"
+#include "hcsr_thresh.h"
 #include "ring_buff.h"
 #include "common.h"
 #include "utils.h"
@@ -89,6 +97,25 @@ static ssize_t hcsr_write(struct file *, const char *, size_t, loff_t *);
  */
 static long hcsr_ioctl(struct file *, unsigned int, unsigned long);
 
+/**
+ * @brief mmap operation of the device, maps the shared result ring.
+ * @param filp, file pointer to the file.
+ * @param vma, the user space area.
+ * @return 0, on success, otherwise failure.
+ */
+static int hcsr_mmap(struct file *, struct vm_area_struct *);
+
+/**
+ * @brief poll operation of the device
+ * @param filp, file pointer to the file.
+ * @param wait, the poll table.
+ * @return POLLIN | POLLRDNORM when results are ready, POLLPRI when a
+ *         threshold event is queued; otherwise 0.
+ * @note once the file is mmap'd, ready means the shared ring moved since
+ *       the previous poll; otherwise the read() watermark is met.
+ */
+static unsigned int hcsr_poll(struct file *, struct poll_table_struct *);
+
 /** File operations supported by this driver */
 struct file_operations fops = {
         .owner = THIS_MODULE,
@@ -96,62 +123,170 @@ struct file_operations fops = {
         .release = hcsr_release,
         .read = hcsr_read,
         .write = hcsr_write,
-        .unlocked_ioctl = hcsr_ioctl
+        .unlocked_ioctl = hcsr_ioctl,
+        .mmap = hcsr_mmap,
+        .poll = hcsr_poll
 };
 
 static int hcsr_open(struct inode *i, struct file *filp) {
         struct hcsr_dev *devp;
+        hcsr_file_t *ctx;
 
         devp = container_of(filp->private_data, struct hcsr_dev, miscdev);
 
-        filp->private_data = devp;
+        ctx = kzalloc(sizeof(hcsr_file_t), GFP_KERNEL);
+        if (ctx == NULL)
+                return -ENOMEM;
+
+        ctx->devp = devp;
+        filp->private_data = ctx;
         return 0;
 }
 
 static int hcsr_release(struct inode *i, struct file *filp) {
+        hcsr_file_t *ctx = (hcsr_file_t *)filp->private_data;
+
+        // The eventfd bound through this file goes with it.
+        hcsr_eventfd_unbind(ctx->devp, filp);
+        kfree(ctx);
+        return 0;
+}
+
+/**
+ * @brief wait until watermark results are queued.
+ * @param devp, a valid device pointer.
+ * @param nonblock, don't wait, only check the queue.
+ * @return 0, results are available; otherwise errno.
+ * @note a one-shot device keeps starting new tasks until the watermark is met,
+ *       a nonblocking reader starts one before getting -EAGAIN.
+ */
+static int hcsr_wait_results(hcsr_dev_t *devp, int nonblock) {
+        unsigned int req;
+
+        while (!hcsr_result_ready(devp)) {
+                if (nonblock) {
+                        // Hand out whatever we have below the watermark.
+                        if (rec_ring_buff_count(devp->result_queue))
+                                return 0;
+                        // Start a round, the retry finds its result.
+                        hcsr_request_join(devp);
+                        return -EAGAIN;
+                }
+                //printk(KERN_INFO "No result, going to request one\n");
+                // Share the round in flight, or start a new one.
+                req = hcsr_request_join(devp);
+                // Waiting for the watermark, our request or an idle device.
+                if (wait_event_interruptible(devp->result_wq,
+                                hcsr_result_ready(devp) ||
+                                hcsr_request_done(devp, req) ||
+                                atomic_read(&devp->available) > 0))
+                        return -ERESTARTSYS;
+                // Another reader drained our result, take a copy instead.
+                if (hcsr_request_done(devp, req) &&
+                    rec_ring_buff_count(devp->result_queue) == 0)
+                        return 1;
+        }
+        return 0;
+}
+
+/**
+ * @brief get the latest result, measuring a new one when it is too old.
+ * @param devp, a valid device pointer.
+ * @param res, storage for the result.
+ * @param max_age, the oldest acceptable result in ms.
+ * @param nonblock, don't wait, only start a round.
+ * @return 0, on success; otherwise errno.
+ * @note the result of the round we waited for is taken whatever its age.
+ */
+static int hcsr_read_cached(hcsr_dev_t *devp, result_info_t *res,
+                            unsigned int max_age, int nonblock) {
+        unsigned int req;
+
+        while (hcsr_get_cached(devp, res, max_age)) {
+                // Share the round in flight, or start a new one.
+                req = hcsr_request_join(devp);
+                if (nonblock)
+                        return -EAGAIN;
+                // Waiting for our request or an idle device.
+                if (wait_event_interruptible(devp->result_wq,
+                                hcsr_request_done(devp, req) ||
+                                atomic_read(&devp->available) > 0))
+                        return -ERESTARTSYS;
+                if (hcsr_request_done(devp, req)) {
+                        hcsr_get_latest(devp, res);
+                        break;
+                }
+        }
         return 0;
 }
 
 static ssize_t hcsr_read(struct file *filp, char *buf,
                  size_t count, loff_t *ppos) {
-        hcsr_dev_t *devp = (hcsr_dev_t *)filp->private_data;
-        result_info_t *result;
+        hcsr_file_t *ctx = (hcsr_file_t *)filp->private_data;
+        hcsr_dev_t *devp = ctx->devp;
+        result_info_t results[HISTORY_SIZE];
+        unsigned long long now;
+        unsigned int n;
+        int ret;
 
         // Invoke ioctl to setup the pins first.
         if (devp->settings.pins.trigger_pin == -1 || devp->settings.pins.echo_pin == -1)
                 return -EINVAL;
 
-        // Security: comparing the count with sizeof(result), take the min one.
-        count = min(count, sizeof(result_info_t));
+        // Drain as many results as fit in the user buffer, at least one.
+        n = clamp_t(unsigned int, count / sizeof(result_info_t), 1, HISTORY_SIZE);
+
+        // Cached mode never hands out the queue, its results may be older.
+        if (ctx->max_age) {
+                ret = hcsr_read_cached(devp, results, ctx->max_age,
+                                       filp->f_flags & O_NONBLOCK);
+                if (ret)
+                        return ret;
+                ret = 1;
+                goto copy;
+        }
 
         // Ring buffer is empty? (Block I/O)
-        if (ring_buff_get(devp->result_queue, (void **)&result)) {
-                //printk(KERN_INFO "No result, going to request one\n");
-                // Someone working on it?
-                if (!hcsr_lock(devp)) {
-                        // None, start a new task.
-                        hcsr_new_task(devp);
-                }
-                // Waiting for the sampling complete and read again.
-                while (ring_buff_get(devp->result_queue, (void **)&result)) {
-                        msleep(devp->settings.params.m * (devp->settings.params.delta));
+        do {
+                ret = hcsr_wait_results(devp, filp->f_flags & O_NONBLOCK);
+                if (ret < 0)
+                        return ret;
+                if (ret > 0) {
+                        // Our round went to another reader, copy it.
+                        hcsr_get_latest(devp, results);
+                        ret = 1;
+                        break;
                 }
-        }
+                // Another reader may have taken them in the meantime.
+                ret = hcsr_get_results(devp, results, n);
+        } while (ret == 0);
 
-        // Copy the result to user.
-        if (copy_to_user(buf, result, count))
-                return -EFAULT;
+        if (ret < 0)
+                return ret;
 
-        kfree(result);
+        // Cached results skip this, they never waited in the queue.
+        now = rdtsc();
+        for (n = 0; n < ret; ++n)
+                hcsr_hist_add(&devp->perf.queue_to_read, now - results[n].timestamp);
 
-        return 0;
+copy:
+
+        // Security: comparing the count with the results, take the min one.
+        count = min(count, ret * sizeof(result_info_t));
+
+        // Copy the results to user.
+        if (copy_to_user(buf, results, count))
+                return -EFAULT;
+
+        return count;
 }
 
 static ssize_t hcsr_write(struct file *filp, const char *buf,
                           size_t count, loff_t *ppos) {
         int value;
 
-        hcsr_dev_t *devp = (hcsr_dev_t *)filp->private_data;
+        hcsr_file_t *ctx = (hcsr_file_t *)filp->private_data;
+        hcsr_dev_t *devp = ctx->devp;
 
         //printk(KERN_INFO "count: %d sizeof: %d\n", count, sizeof(int));
 
@@ -166,61 +301,130 @@ static ssize_t hcsr_write(struct file *filp, const char *buf,
         if (copy_from_user(&value, buf, count))
                 return -EFAULT;
 
-        // lock the device
-        if (hcsr_lock(devp))
-                return -EBUSY;
-
         //printk(KERN_INFO "The value is %d\n", value);
         // clear all result_queue if the value is non-0.
         if (value) {
                 //printk(KERN_ALERT "Going to clean up the ring buff\n");
-                ring_buff_removeall(devp->result_queue);
+                mutex_lock(&devp->queue_lock);
+                rec_ring_buff_removeall(devp->result_queue);
+                mutex_unlock(&devp->queue_lock);
         }
 
-        // start a new sampling by starting a new thread
-        hcsr_new_task(devp);
+        // Start a new sampling, or share the one in flight.
+        hcsr_request_join(devp);
 
         return 0;
 }
 
 static long hcsr_ioctl(struct file *filp, unsigned int cmd, unsigned long arg) {
-        hcsr_dev_t *devp = filp->private_data;
+        hcsr_file_t *ctx = filp->private_data;
+        hcsr_dev_t *devp = ctx->devp;
         pins_setting_t pins;
         parameters_setting_t params;
+        filter_setting_t filter;
+        eventfd_setting_t evfd;
+        threshold_setting_t thresh;
+        threshold_event_t event;
+        unsigned int watermark;
+        unsigned int max_age;
+        unsigned int acked;
         int ret;
 
-        // Not allow ioctl configuration during the sampling job.
-        if (hcsr_lock(devp))
-                return -EBUSY;
+        // Readers' setting, allowed during the sampling job.
+        if (cmd == SET_WATERMARK) {
+                if (copy_from_user(&watermark, (unsigned int *)arg,
+                                   sizeof(unsigned int)))
+                        return -EFAULT;
+                if (watermark < 1 || watermark > HISTORY_SIZE)
+                        return -EINVAL;
+                devp->settings.watermark = watermark;
+                return 0;
+        }
+
+        // Per file read mode, allowed during the sampling job as well.
+        if (cmd == SET_MAX_AGE) {
+                if (copy_from_user(&max_age, (unsigned int *)arg,
+                                   sizeof(unsigned int)))
+                        return -EFAULT;
+                if (max_age > MAX_AGE)
+                        return -EINVAL;
+                ctx->max_age = max_age;
+                return 0;
+        }
+
+        // Reader of the shared ring moving on, allowed during the sampling job as well.
+        if (cmd == ACK_MMAP) {
+                if (copy_from_user(&acked, (unsigned int *)arg,
+                                   sizeof(unsigned int)))
+                        return -EFAULT;
+                // Can't be past what the producer published.
+                if (!ctx->mapped || (int)(hcsr_mmap_head(devp) - acked) < 0)
+                        return -EINVAL;
+                ctx->mmap_acked = acked;
+                return 0;
+        }
+
+        // Notification binding, allowed during the sampling job as well.
+        if (cmd == SET_EVENTFD) {
+                if (copy_from_user(&evfd, (eventfd_setting_t *)arg,
+                                   sizeof(eventfd_setting_t)))
+                        return -EFAULT;
+                return hcsr_eventfd_bind(devp, filp, &evfd);
+        }
+
+        // Threshold events, allowed during the sampling job as well.
+        if (cmd == SET_THRESHOLD) {
+                if (copy_from_user(&thresh, (threshold_setting_t *)arg,
+                                   sizeof(threshold_setting_t)))
+                        return -EFAULT;
+                if (hcsr_thresh_validate(&thresh))
+                        return -EINVAL;
+                hcsr_thresh_set(devp, &thresh);
+                return 0;
+        }
+
+        if (cmd == GET_EVENT) {
+                ret = hcsr_thresh_get(devp, &event, filp->f_flags & O_NONBLOCK);
+                if (ret)
+                        return ret;
+                if (copy_to_user((threshold_event_t *)arg, &event,
+                                 sizeof(threshold_event_t)))
+                        return -EFAULT;
+                return 0;
+        }
+
+        // Not allow ioctl configuration during the sampling job, wait it out.
+        ret = hcsr_lock_wait(devp, filp->f_flags & O_NONBLOCK);
+        if (ret)
+                return ret;
 
         switch (cmd) {
                 case CONFIG_PINS:
                         if (copy_from_user(&pins, (pins_setting_t *)arg, 
                                            sizeof(pins_setting_t)))
                                 goto failed;
-                        // Validate the pins.
-                        if (hcsr04_config_validate(&pins))
+                        // Both pins are required here.
+                        if (pins.trigger_pin < 0 || pins.echo_pin < 0)
                                 goto failed;
 
                         // Remove isr and irq_no
                         hcsr_isr_exit(devp);
-                        
-                        // Remove previous GPIO setup
-                        if (hcsr04_config_fini(&devp->settings.pins))
-                                goto failed;
 
-                        // Assign to the device.
-                        devp->settings.pins.trigger_pin = -1;
-                        devp->settings.pins.echo_pin = -1;
-                        
-                        // Configure pins.
-                        if (hcsr04_config_init(&pins))
+                        // Move to the new pins, only the lines that differ are touched.
+                        if (hcsr04_config_update(&devp->settings.pins, &pins)) {
+                                // The old pins stay, so does their isr.
+                                if (devp->irq_no && hcsr_isr_init(devp) < 0)
+                                        devp->irq_no = 0;
                                 goto failed;
+                        }
 
                         // Assign to the device.
                         devp->settings.pins.trigger_pin = pins.trigger_pin;
                         devp->settings.pins.echo_pin = pins.echo_pin;
 
+                        // New sensor, forget the tracked distance.
+                        hcsr_filter_init(&devp->filter, &devp->filter.setting);
+
                         // Setup isr and irq_no
                         ret = hcsr_isr_init(devp);
                         if (ret < 0) {
@@ -242,14 +446,22 @@ static long hcsr_ioctl(struct file *filp, unsigned int cmd, unsigned long arg) {
                                 printk(KERN_ALERT "Should have at least 60ms\n");
                                 goto failed;
                         }
+                        if (params.m < 1)
+                                goto failed;
                         devp->settings.params.delta = params.delta;
 
-                        // Reallocate the sampling buffer.
-                        if (hcsr_reallocate(devp, params.m + NUM_OF_OUTLIER))
-                                goto failed;
                         // Assign to the device.
                         devp->settings.params.m = params.m + NUM_OF_OUTLIER;
                         break;
+                case SET_FILTER:
+                        if (copy_from_user(&filter, (filter_setting_t *)arg,
+                                           sizeof(filter_setting_t)))
+                                goto failed;
+                        if (hcsr_filter_validate(&filter))
+                                goto failed;
+                        // Start over, tracker state belongs to the old filter.
+                        hcsr_filter_init(&devp->filter, &filter);
+                        break;
                 default:
                         hcsr_unlock(devp);
                         return -EINVAL;
@@ -263,7 +475,66 @@ failed:
         return -EFAULT;
 }
 
+static int hcsr_mmap(struct file *filp, struct vm_area_struct *vma) {
+        hcsr_file_t *ctx = filp->private_data;
+        int ret;
+
+        ret = hcsr_mmap_map(ctx->devp, vma);
+        if (ret)
+                return ret;
+
+        // From now on poll follows the shared ring on this file.
+        ctx->mmap_acked = hcsr_mmap_head(ctx->devp);
+        ctx->mapped = 1;
+        return 0;
+}
+
+static unsigned int hcsr_poll(struct file *filp, struct poll_table_struct *wait) {
+        hcsr_file_t *ctx = filp->private_data;
+        hcsr_dev_t *devp = ctx->devp;
+        unsigned int head;
+        unsigned int mask;
+
+        poll_wait(filp, &devp->thresh.wq, wait);
+        mask = hcsr_thresh_pending(devp) ? POLLPRI : 0;
+
+        if (!ctx->mapped) {
+                poll_wait(filp, &devp->result_wq, wait);
+                return hcsr_result_ready(devp) ? mask | POLLIN | POLLRDNORM : mask;
+        }
+
+        // Readable until the reader acknowledges the results it took.
+        poll_wait(filp, &devp->mmap_wq, wait);
+        head = hcsr_mmap_head(devp);
+        if (head == ACCESS_ONCE(ctx->mmap_acked))
+                return mask;
+        return mask | POLLIN | POLLRDNORM;
+}
+
 #ifdef NORMAL_MODULE
+/**
+ * @brief undo everything hcsr04_init set up for one device.
+ * @param devp, a device registered completely.
+ */
+static void hcsr04_remove_one(hcsr_dev_t *devp) {
+        // The thread fires the iio trigger, stop it first.
+        hcsr_stop_one(devp);
+
+        hcsr_iio_remove(devp);
+
+        hcsr_ctl_remove(devp);
+
+        // Unregister the device driver from the file system.
+        sysfs_remove_groups(&(devp->miscdev.this_device->kobj), hcsr_groups);
+
+        class_compat_remove_link(s_dev_class, devp->miscdev.this_device, NULL);
+
+        // Remove from miscdev chain
+        misc_deregister(&devp->miscdev);
+
+        hcsr_fini_one(devp);
+}
+
 static int hcsr04_init(void) {
         int i;
         int ret;
@@ -274,19 +545,46 @@ static int hcsr04_init(void) {
         if (n > 10)
                 return -EINVAL;
 
+        // Calibrate the TSC for distance and age conversions.
+        ret = hcsr_conv_init();
+        if (ret)
+                return ret;
+
+        // Bind to the gpio simulator when asked for.
+        ret = hcsr_sim_init();
+        if (ret)
+                return ret;
+
+        // Statistics of every device go below one debugfs directory.
+        hcsr_debugfs_init();
+
         // Allocate space for the structure
         dev = kzalloc(sizeof(struct hcsr_dev) * n, GFP_KERNEL);
         if (dev == NULL) {
-                return -ENOMEM;
+                ret = -ENOMEM;
+                goto free_debugfs;
         }
 
         // Create a compatible class for device object
         s_dev_class = class_compat_register(CLASS_NAME);
+        if (s_dev_class == NULL) {
+                ret = -ENOMEM;
+                goto free_dev;
+        }
+
+        // Control node acting on all devices.
+        ret = hcsr_ctl_init();
+        if (ret)
+                goto free_class;
 
         for (i = 0; i < n; ++i) {
                 snprintf(dev[i].name, BUFF_SIZE, "%s%d", DEVICE_NAME_PREFIX, i);
                 ret = hcsr_init_one(&dev[i]);
-                
+                if (ret) {
+                        printk(KERN_ALERT "init %s failed\n", dev[i].name);
+                        goto free_devices;
+                }
+
                 // Create miscdev
                 dev[i].miscdev.minor = MISC_DYNAMIC_MINOR;
                 dev[i].miscdev.name = dev[i].name;
@@ -294,8 +592,8 @@ static int hcsr04_init(void) {
                 ret = misc_register(&dev[i].miscdev);
                 if (ret) {
                         printk(KERN_ALERT "misc_register failed\n");
-                        // ToDo: clear up before return an error.
-                        return ret;
+                        hcsr_fini_one(&dev[i]);
+                        goto free_devices;
                 }
 
                 // Register the device driver to the file system.
@@ -303,28 +601,43 @@ static int hcsr04_init(void) {
 
                 sysfs_create_groups(&(dev[i].miscdev.this_device->kobj), hcsr_groups);
 
-                if (ret) {
-                        return ret;
-                }
+                hcsr_ctl_add(&dev[i]);
+
+                // IIO front-end, best effort.
+                if (hcsr_iio_add(&dev[i], dev[i].miscdev.this_device))
+                        printk(KERN_INFO "no iio device for %s\n", dev[i].name);
         }
 
         return 0;
+
+free_devices:
+        // Only the devices before the failed one were set up.
+        while (i--)
+                hcsr04_remove_one(&dev[i]);
+        hcsr_ctl_exit();
+free_class:
+        class_compat_unregister(s_dev_class);
+        s_dev_class = NULL;
+free_dev:
+        kfree(dev);
+        dev = NULL;
+free_debugfs:
+        hcsr_debugfs_exit();
+        hcsr_sim_exit();
+        return ret;
 }
 
 static void hcsr04_exit(void) {
         int i;
         printk(KERN_ALERT "Goodbye, world\n");
-        for (i = 0; i < n; ++i) {
-                // Unregister the device driver from the file system.
-                sysfs_remove_groups(&(dev[i].miscdev.this_device->kobj), hcsr_groups);
+        for (i = 0; i < n; ++i)
+                hcsr04_remove_one(&dev[i]);
 
-                class_compat_remove_link(s_dev_class, dev[i].miscdev.this_device, NULL);
+        hcsr_ctl_exit();
 
-                // Remove from miscdev chain
-                misc_deregister(&dev[i].miscdev);
+        hcsr_debugfs_exit();
 
-                hcsr_fini_one(&dev[i]);
-        }
+        hcsr_sim_exit();
 
         // Destroy driver_class
         class_compat_unregister(s_dev_class);
@@ -348,12 +661,23 @@ static int hcsr_driver_probe(struct platform_device *pdevp)
         
         snprintf(devp->name, BUFF_SIZE, "%s", pdevp->name);
         ret = hcsr_init_one(devp);
+        if (ret) {
+                // Nothing else set up yet, remove won't be called.
+                kfree(hdevp->dev);
+                hdevp->dev = NULL;
+                return ret;
+        }
 
         class_compat_create_link(s_dev_class, &pdevp->dev, NULL);
 
         sysfs_create_files(&(pdevp->dev.kobj), (const struct attribute **)hcsr_attrs);
 
-        //[ToDo] Add to the device list.
+        // Add to the device list.
+        hcsr_ctl_add(devp);
+
+        // IIO front-end, best effort.
+        if (hcsr_iio_add(devp, &pdevp->dev))
+                printk(KERN_INFO "no iio device for %s\n", devp->name);
 
         return ret;
 };
@@ -368,6 +692,14 @@ static int hcsr_driver_remove(struct platform_device *pdevp)
         
         printk(KERN_ALERT "Removing the device -- %s\n", devp->name);
 
+        // The thread fires the iio trigger, stop it first.
+        hcsr_stop_one(devp);
+
+        hcsr_iio_remove(devp);
+
+        // Remove from the device list.
+        hcsr_ctl_remove(devp);
+
         sysfs_remove_files(&(pdevp->dev.kobj), (const struct attribute **)hcsr_attrs);
 
         class_compat_remove_link(s_dev_class, &pdevp->dev, NULL);
@@ -376,8 +708,6 @@ static int hcsr_driver_remove(struct platform_device *pdevp)
 
         kfree(hdevp->dev);
 
-        //[ToDo] Remove from the device list.
-
         return 0;
 };
 
@@ -392,22 +722,62 @@ static struct platform_driver hcsr_of_driver = {
 };
 
 static int hcsr04_init(void) {
+        int ret;
+
+        // Calibrate the TSC for distance and age conversions.
+        ret = hcsr_conv_init();
+        if (ret)
+                return ret;
+
+        // Bind to the gpio simulator when asked for.
+        ret = hcsr_sim_init();
+        if (ret)
+                return ret;
+
+        // Statistics of every device go below one debugfs directory.
+        hcsr_debugfs_init();
+
         // Create a compatible class for device object
         s_dev_class = class_compat_register(CLASS_NAME);
+        if (s_dev_class == NULL) {
+                ret = -ENOMEM;
+                goto free_debugfs;
+        }
 
-        platform_driver_register(&hcsr_of_driver);
+        // Control node acting on every device on the list.
+        ret = hcsr_ctl_init();
+        if (ret)
+                goto free_class;
 
-        // [ToDo] Maintain a device list initialized by this driver.
+        // Probed devices add themselves to the list.
+        ret = platform_driver_register(&hcsr_of_driver);
+        if (ret)
+                goto free_ctl;
 
         return 0;
+
+free_ctl:
+        hcsr_ctl_exit();
+free_class:
+        class_compat_unregister(s_dev_class);
+        s_dev_class = NULL;
+free_debugfs:
+        hcsr_debugfs_exit();
+        hcsr_sim_exit();
+        return ret;
 }
 static void hcsr04_exit(void) {
         platform_driver_unregister(&hcsr_of_driver);
 
+        hcsr_debugfs_exit();
+
+        hcsr_sim_exit();
+
+        // Removed devices left the list, nothing to clear up.
+        hcsr_ctl_exit();
+
         // Destroy driver_class
         class_compat_unregister(s_dev_class);
-
-        // [ToDo] Clear up the device on the list.
 }
 #endif //NORMAL_MODULE
 
@@ -4,8 +4,11 @@
  * @author Xiangyu Guo
  */
 #include <linux/gpio.h>
+#include <linux/delay.h>
+#include <linux/mutex.h>
 
 #include "hcsr_config.h"
+#include "hcsr_sim.h"
 
 typedef struct multi_plexing {
         int logic;                      /**< Linux Logic Pin */
@@ -143,6 +146,33 @@ static multi_plexing_t shield_pins[] = {
 /**< Flag to store the pin usage status */
 static unsigned int pin_usage = 0;
 
+#define NUM_OF_LINES    (80)                    /**< Linux GPIO lines behind the shield */
+#define EXPANDER_BASE   (64)                    /**< Lines from here on sit on the I2C PWM expander */
+
+#define HELD_LOGIC      (1 << 0)                /**< Shield pin holds its logic line */
+#define HELD_DIR        (1 << 1)                /**< Shield pin holds its dir line */
+#define HELD_MUX1       (1 << 2)                /**< Shield pin holds its mux1 line */
+#define HELD_MUX2       (1 << 3)                /**< Shield pin holds its mux2 line */
+
+typedef struct gpio_line {
+        unsigned int users;             /**< Shield pins holding the line */
+        int owned;                      /**< Line requested from gpiolib */
+        int driven;                     /**< Expander line set to its direction */
+        int flag;                       /**< Current GPIOF setting, -1 unknown */
+} gpio_line_t;
+
+/**< Cached state of every line, so reconfiguration only touches the diff */
+static gpio_line_t gpio_lines[NUM_OF_LINES];
+
+/**< Lines each shield pin holds */
+static unsigned char pin_held[ARRAY_SIZE(shield_pins)];
+
+/**< Expander lines with a level not written yet */
+static unsigned int expander_dirty = 0;
+
+/**< Serializes the devices reconfiguring the shared line cache */
+static DEFINE_MUTEX(config_lock);
+
 /**< Flag to represent the pin support interrupt both */
 static unsigned int interrupt_both = 0b01 << 2  |
                                      0b01 << 3  |
@@ -172,96 +202,202 @@ static void hcsr04_set_pwm_value(int flag, int pin) {
         }
 }
 
-int hcsr04_init_pins(int pin, int dir) {
+/**
+ * @brief take a reference on a line and drive it, touching the hardware
+ *        only if the line is not ours yet or its setting changes.
+ * @param gpio, GPIO pin number.
+ * @param flag, the GPIOF setting of the line.
+ * @return 0 on success, otherwise errno.
+ * @note expander lines are written by hcsr04_line_flush.
+ */
+static int hcsr04_line_get(int gpio, int flag) {
+        gpio_line_t *line = &gpio_lines[gpio];
         int ret;
-        int flag = GPIOF_OUT_INIT_LOW;
-        multi_plexing_t *mp = &shield_pins[pin];
-        printk(KERN_INFO "shield: %d, logic: %d, dir: %d, mux1: %d, mux2: %d, mux: %d\n",
-                pin, mp->logic, mp->dir, mp->mux1, mp->mux2, mp->mux);
 
-        if (dir == INPUT) {
-            flag = GPIOF_IN;
-        }
-        // logic
-        ret = gpio_request_one(mp->logic, flag, NULL);
-        if (ret) {
-                printk(KERN_ALERT "Config GPIO %d failed!\n", mp->logic);
-                return -EBUSY;
+        if (!line->owned) {
+                // Expander lines get their level at the flush.
+                if (gpio < EXPANDER_BASE)
+                        ret = gpio_request_one(gpio, flag, NULL);
+                else
+                        ret = gpio_request(gpio, NULL);
+                if (ret)
+                        return ret;
+                line->owned = 1;
+                line->flag = gpio < EXPANDER_BASE ? flag : -1;
         }
+        line->users++;
 
-        if (dir == INPUT) {
-            flag = GPIOF_OUT_INIT_HIGH;
-        }
-        // dir
-        if (mp->dir != -1) {
-                ret = gpio_request_one(mp->dir, flag, NULL);
+        if (line->flag == flag)
+                return 0;
+
+        if (gpio >= EXPANDER_BASE)
+                expander_dirty |= 1 << (gpio - EXPANDER_BASE);
+        else if (flag == GPIOF_IN)
+                gpio_direction_input(gpio);
+        else
+                gpio_direction_output(gpio, flag == GPIOF_OUT_INIT_HIGH);
+        line->flag = flag;
+        return 0;
+}
+
+/**
+ * @brief drop a reference on a line, hcsr04_line_sweep frees it.
+ * @param gpio, GPIO pin number.
+ */
+static void hcsr04_line_put(int gpio) {
+        if (gpio_lines[gpio].users)
+                gpio_lines[gpio].users--;
+}
+
+/**
+ * @brief free the lines nobody holds any more.
+ */
+static void hcsr04_line_sweep(void) {
+        int gpio;
+
+        for (gpio = 0; gpio < NUM_OF_LINES; ++gpio) {
+                if (!gpio_lines[gpio].owned || gpio_lines[gpio].users)
+                        continue;
+                gpio_free(gpio);
+                gpio_lines[gpio].owned = 0;
+                gpio_lines[gpio].driven = 0;
+                gpio_lines[gpio].flag = -1;
+                if (gpio >= EXPANDER_BASE)
+                        expander_dirty &= ~(1 << (gpio - EXPANDER_BASE));
         }
-        // mux1
-        if (mp->mux1 != -1 && mp->mux1 < 64) {
-                ret = gpio_request_one(mp->mux1, mp->mux, NULL);
-        } else if (mp->mux1 != -1) {
-                ret = gpio_request(mp->mux1, NULL);
-                hcsr04_set_pwm_value(mp->mux, mp->mux1);
+}
+
+/**
+ * @brief write the changed expander lines, once each.
+ * @note the first write of a line also sets its direction.
+ */
+static void hcsr04_line_flush(void) {
+        int i;
+        gpio_line_t *line;
+
+        // Only the final level of a reconfiguration goes over I2C.
+        for (i = 0; expander_dirty; ++i) {
+                if (!(expander_dirty & (1 << i)))
+                        continue;
+                expander_dirty &= ~(1 << i);
+                line = &gpio_lines[EXPANDER_BASE + i];
+                if (line->driven) {
+                        hcsr04_set_pwm_value(line->flag, EXPANDER_BASE + i);
+                        continue;
+                }
+                // Requested without a direction, set it along with the level.
+                if (line->flag == GPIOF_IN)
+                        gpio_direction_input(EXPANDER_BASE + i);
+                else
+                        gpio_direction_output(EXPANDER_BASE + i, line->flag == GPIOF_OUT_INIT_HIGH);
+                line->driven = 1;
         }
-        // mux2
-        if (mp->mux2 != -1 && mp->mux2 < 64) {
-                ret = gpio_request_one(mp->mux2, mp->mux, NULL);
-        } else if (mp->mux2 != -1) {
-                ret = gpio_request(mp->mux2, NULL);
-                hcsr04_set_pwm_value(mp->mux, mp->mux2);
+}
+
+/**
+ * @brief setting up a pin on the simulator chip, no multiplexing there.
+ * @param pin, shield pin number.
+ * @param dir, direction of the shield pin.
+ * @return 0 on success, otherwise errno.
+ */
+static int hcsr04_init_sim_pin(int pin, int dir) {
+        int gpio = hcsr_sim_shield_to_gpio(pin);
+
+        if (gpio < 0 || gpio_request_one(gpio, dir == INPUT ? GPIOF_IN :
+                                         GPIOF_OUT_INIT_LOW, NULL)) {
+                printk(KERN_ALERT "Config GPIO %d failed!\n", gpio);
+                return -EBUSY;
         }
         pin_usage |= (1 << pin);
         return 0;
 }
 
-int hcsr04_init_trigger(int pin) {
-        int ret;
+/**
+ * @brief drop the lines of a shield pin.
+ * @param pin, shield pin number.
+ */
+static void hcsr04_put_pin(int pin) {
+        multi_plexing_t *mp = &shield_pins[pin];
+
+        if (hcsr_sim_enabled()) {
+                gpio_free(hcsr_sim_shield_to_gpio(pin));
+                pin_usage &= ~(1 << pin);
+                return;
+        }
+
+        if (pin_held[pin] & HELD_LOGIC)
+                hcsr04_line_put(mp->logic);
+        if (pin_held[pin] & HELD_DIR)
+                hcsr04_line_put(mp->dir);
+        if (pin_held[pin] & HELD_MUX1)
+                hcsr04_line_put(mp->mux1);
+        if (pin_held[pin] & HELD_MUX2)
+                hcsr04_line_put(mp->mux2);
+        pin_held[pin] = 0;
+        pin_usage &= ~(1 << pin);
+}
+
+/**
+ * @brief take the lines of a shield pin.
+ * @param pin, shield pin number.
+ * @param dir, direction of the shield pin.
+ * @return 0 on success, otherwise errno.
+ */
+static int hcsr04_get_pin(int pin, int dir) {
         multi_plexing_t *mp = &shield_pins[pin];
+
+        if (hcsr_sim_enabled())
+                return hcsr04_init_sim_pin(pin, dir);
+
         printk(KERN_INFO "shield: %d, logic: %d, dir: %d, mux1: %d, mux2: %d, mux: %d\n",
                 pin, mp->logic, mp->dir, mp->mux1, mp->mux2, mp->mux);
+
         // logic
-        ret = gpio_request_one(mp->logic, GPIOF_OUT_INIT_LOW, NULL);
-        if (ret) {
+        if (hcsr04_line_get(mp->logic, dir == INPUT ? GPIOF_IN : GPIOF_OUT_INIT_LOW)) {
                 printk(KERN_ALERT "Config GPIO %d failed!\n", mp->logic);
                 return -EBUSY;
         }
+        pin_held[pin] = HELD_LOGIC;
+
         // dir
         if (mp->dir != -1) {
-                ret = gpio_request_one(mp->dir, GPIOF_OUT_INIT_LOW, NULL);
+                if (hcsr04_line_get(mp->dir, dir == INPUT ? GPIOF_OUT_INIT_HIGH : GPIOF_OUT_INIT_LOW))
+                        goto failed;
+                pin_held[pin] |= HELD_DIR;
         }
         // mux1
-        if (mp->mux1 != -1 && mp->mux1 < 64) {
-                ret = gpio_request_one(mp->mux1, mp->mux, NULL);
-        } else if (mp->mux1 != -1) {
-                ret = gpio_request(mp->mux1, NULL);
-                hcsr04_set_pwm_value(mp->mux, mp->mux1);
+        if (mp->mux1 != -1) {
+                if (hcsr04_line_get(mp->mux1, mp->mux))
+                        goto failed;
+                pin_held[pin] |= HELD_MUX1;
         }
         // mux2
-        if (mp->mux2 != -1 && mp->mux2 < 64) {
-                ret = gpio_request_one(mp->mux2, mp->mux, NULL);
-        } else if (mp->mux2 != -1) {
-                ret = gpio_request(mp->mux2, NULL);
-                hcsr04_set_pwm_value(mp->mux, mp->mux2);
+        if (mp->mux2 != -1) {
+                if (hcsr04_line_get(mp->mux2, mp->mux))
+                        goto failed;
+                pin_held[pin] |= HELD_MUX2;
         }
+
         pin_usage |= (1 << pin);
         return 0;
+
+failed:
+        // A pin without its mux is no pin, drop the lines taken so far.
+        printk(KERN_ALERT "Config mux of shield pin %d failed!\n", pin);
+        hcsr04_put_pin(pin);
+        return -EBUSY;
 }
 
 int hcsr04_fini_pins(int pin) {
-        multi_plexing_t *mp = &shield_pins[pin];
-        gpio_free(mp->logic);
-        if (mp->dir != -1)
-                gpio_free(mp->dir);
-        if (mp->mux1 != - 1)
-                gpio_free(mp->mux1);
-        if (mp->mux2 != -1)
-                gpio_free(mp->mux2);
-        pin_usage &= ~(1 << pin);
+        mutex_lock(&config_lock);
+        hcsr04_put_pin(pin);
+        hcsr04_line_sweep();
+        mutex_unlock(&config_lock);
         return 0;
 }
 
 int hcsr04_config_validate_pin(int pin) {
-        if (0 > pin || 20 < pin) {
+        if (0 > pin || pin >= ARRAY_SIZE(shield_pins)) {
                 printk(KERN_ALERT "Pin(s) not in the correct range!\n");
                 return -EINVAL;
         }
@@ -273,6 +409,10 @@ int hcsr04_config_validate_pin(int pin) {
 }
 
 int hcsr04_config_validate_echo(int pin) {
+        // Every simulator line can interrupt on both edges.
+        if (hcsr_sim_enabled())
+                return 0;
+
         if (~interrupt_both & (1 << pin)) {
                 printk(KERN_ALERT "This pin can't be echo pin!\n");
                 return -EINVAL;
@@ -280,44 +420,83 @@ int hcsr04_config_validate_echo(int pin) {
         return 0;
 }
 
-int hcsr04_config_validate(pins_setting_t *pins) {
+int hcsr04_config_init(pins_setting_t *pins) {
+        pins_setting_t none = { .trigger_pin = -1, .echo_pin = -1 };
 
-        if (hcsr04_config_validate_pin(pins->trigger_pin) ||
-            hcsr04_config_validate_pin(pins->echo_pin)) {
-                return -EINVAL;
-        }
+        return hcsr04_config_update(&none, pins);
+}
 
-        if (hcsr04_config_validate_echo(pins->echo_pin))
-                return -EINVAL;
+int hcsr04_config_fini(pins_setting_t *pins) {
+        pins_setting_t none = { .trigger_pin = -1, .echo_pin = -1 };
 
-        return 0;
+        return hcsr04_config_update(pins, &none);
 }
 
-int hcsr04_config_init(pins_setting_t *pins) {
-        if (hcsr04_config_validate(pins))
-                return -EINVAL;
+int hcsr04_config_update(pins_setting_t *old, pins_setting_t *pins) {
+        int ret = -EINVAL;
 
-        if (hcsr04_init_pins(pins->trigger_pin, OUTPUT) || 
-                hcsr04_init_pins(pins->echo_pin, INPUT))
-                return -EBUSY;
+        mutex_lock(&config_lock);
+        // Release the old pins, but keep their lines until the new ones are in.
+        if (old->trigger_pin != -1)
+                hcsr04_put_pin(old->trigger_pin);
+        if (old->echo_pin != -1)
+                hcsr04_put_pin(old->echo_pin);
 
-        pin_usage |= (1 << pins->trigger_pin) | (1 << pins->echo_pin);
-        return 0;
-}
+        if ((pins->trigger_pin != -1 && hcsr04_config_validate_pin(pins->trigger_pin)) ||
+            (pins->echo_pin != -1 && (hcsr04_config_validate_pin(pins->echo_pin) ||
+                                      hcsr04_config_validate_echo(pins->echo_pin))) ||
+            (pins->trigger_pin != -1 && pins->trigger_pin == pins->echo_pin))
+                goto restore;
 
-int hcsr04_config_fini(pins_setting_t *pins) {
-        if (pins->trigger_pin == -1 || pins->echo_pin == -1)
-                return 0;
+        ret = -EBUSY;
+        if (pins->trigger_pin != -1 && hcsr04_get_pin(pins->trigger_pin, OUTPUT))
+                goto restore;
+        if (pins->echo_pin != -1 && hcsr04_get_pin(pins->echo_pin, INPUT)) {
+                if (pins->trigger_pin != -1)
+                        hcsr04_put_pin(pins->trigger_pin);
+                goto restore;
+        }
 
-        hcsr04_fini_pins(pins->trigger_pin);
-        hcsr04_fini_pins(pins->echo_pin);
-        pin_usage &= ~((1 << pins->trigger_pin) | (1 << pins->echo_pin));
+        // Only lines nobody holds any more are freed.
+        hcsr04_line_sweep();
+        hcsr04_line_flush();
+        mutex_unlock(&config_lock);
         return 0;
+restore:
+        // The old lines are still ours, getting them back costs nothing.
+        // Simulator lines are freed right away though, and may be gone.
+        if (old->trigger_pin != -1 && hcsr04_get_pin(old->trigger_pin, OUTPUT)) {
+                printk(KERN_ALERT "Lost trigger pin %d!\n", old->trigger_pin);
+                old->trigger_pin = -1;
+        }
+        if (old->echo_pin != -1 && hcsr04_get_pin(old->echo_pin, INPUT)) {
+                printk(KERN_ALERT "Lost echo pin %d!\n", old->echo_pin);
+                old->echo_pin = -1;
+        }
+        hcsr04_line_sweep();
+        hcsr04_line_flush();
+        mutex_unlock(&config_lock);
+        return ret;
 }
 
 int hcsr04_shield_to_gpio(int pin) {
-        if (pin < 0 || pin > ARRAY_SIZE(shield_pins))
+        if (hcsr_sim_enabled())
+                return hcsr_sim_shield_to_gpio(pin);
+
+        if (pin < 0 || pin >= ARRAY_SIZE(shield_pins))
                 return -EINVAL;
 
         return shield_pins[pin].logic;
 }
+
+void hcsr04_trigger(pins_setting_t *pins) {
+        int gpio = hcsr04_shield_to_gpio(pins->trigger_pin);
+
+        gpio_set_value_cansleep(gpio, 1);
+        udelay(10);
+        gpio_set_value_cansleep(gpio, 0);
+
+        // No sensor on the simulator, answer with a synthetic echo.
+        if (hcsr_sim_enabled())
+                hcsr_sim_echo(pins->echo_pin);
+}
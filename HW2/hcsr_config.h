@@ -27,13 +27,6 @@ int hcsr04_config_validate_pin(int);
  */
 int hcsr04_config_validate_echo(int);
 
-/** 
- * @brief validate the pin.
- * @param pins, a valid pointer to the pins structure.
- * @return 0 on success, otherwise errno.
- */
-int hcsr04_config_validate(pins_setting_t *);
-
 /** 
  * @brief setup the pins.
  * @param pins, a valid pointer to the pins structure.
@@ -49,12 +42,15 @@ int hcsr04_config_init(pins_setting_t *);
 int hcsr04_config_fini(pins_setting_t *);
 
 /** 
- * @brief setting up pin.
- * @param pin, shield pin number.
- * @param dir, direction of the shield pin.
- * @return 0 on success, otherwise errno.
+ * @brief move from one pin setup to another, -1 pins are unset.
+ * @param old, a valid pointer to the pins in use.
+ * @param pins, a valid pointer to the new pins.
+ * @return 0 on success, otherwise errno and the old pins stay, those that
+ *         could not be taken back are set to -1.
+ * @note lines both setups share keep their ownership and are only written
+ *       when their level changes.
  */
-int hcsr04_init_pins(int, int);
+int hcsr04_config_update(pins_setting_t *, pins_setting_t *);
 
 /** 
  * @brief free up all pins.
@@ -70,4 +66,10 @@ int hcsr04_fini_pins(int);
  */
 int hcsr04_shield_to_gpio(int pin);
 
+/** 
+ * @brief send one 10us trigger pulse.
+ * @param pins, a valid pointer to the pins structure.
+ */
+void hcsr04_trigger(pins_setting_t *);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+/**
+ * @file hcsr_conv.c
+ * @brief Calibrated conversion of TSC ticks to time and distance.
+ * 
+ * @author Xiangyu Guo
+ */
+#include <linux/kernel.h>
+#include <linux/delay.h>
+#include <linux/ktime.h>
+
+#include <asm/tsc.h>
+
+#include "hcsr_conv.h"
+
+#include "utils.h"
+
+#define NS_SHIFT        (24)                    /**< Fraction bits of the ns multiplier */
+#define CALIB_MS        (20)                    /**< Calibration period without tsc_khz */
+
+static unsigned int s_khz = 0;                  /**< TSC ticks per ms */
+static unsigned int s_ns_mult = 0;              /**< ns per TSC tick, NS_SHIFT fraction bits */
+
+/**
+ * @brief count TSC ticks against the monotonic clock.
+ * @return TSC ticks per ms.
+ */
+static unsigned int hcsr_conv_measure(void) {
+        unsigned long long tsc;
+        ktime_t start;
+        s64 ns;
+
+        start = ktime_get();
+        tsc = rdtsc();
+        mdelay(CALIB_MS);
+        tsc = rdtsc() - tsc;
+        ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+        return div64_u64(tsc * NSEC_PER_MSEC, ns);
+}
+
+int hcsr_conv_init(void) {
+        // The kernel calibrated the TSC at boot already, use that.
+        s_khz = tsc_khz ? tsc_khz : hcsr_conv_measure();
+        if (s_khz == 0)
+                return -ENODEV;
+
+        s_ns_mult = div_u64((unsigned long long)NSEC_PER_MSEC << NS_SHIFT, s_khz);
+        printk(KERN_INFO "TSC %u kHz\n", s_khz);
+        return 0;
+}
+
+unsigned long long hcsr_conv_to_ns(unsigned long long ticks) {
+        return mul_u64_u32_shr(ticks, s_ns_mult, NS_SHIFT);
+}
+
+unsigned int hcsr_conv_mult(int temperature) {
+        // Speed of sound in 0.1 m/s, 331.3 + 0.606 T.
+        unsigned long long speed = 3313 + 606 * temperature / 100;
+
+        // Round trip: mm = ticks * speed / (2 * 10 * khz).
+        return div_u64(speed << CONV_SHIFT, 20 * s_khz);
+}
@@ -0,0 +1,57 @@
+/**
+ * @file hcsr_conv.h
+ * @brief Calibrated conversion of TSC ticks to time and distance.
+ * 
+ * @author Xiangyu Guo
+ */
+#ifndef __HCSR_CONV_H__
+#define __HCSR_CONV_H__
+
+#include <linux/math64.h>
+
+#define CONV_SHIFT      (32)                    /**< Fraction bits of the distance multiplier */
+#define DEFAULT_TEMP    (20)                    /**< Default ambient temperature in C */
+#define MIN_TEMP        (-40)                   /**< Coldest temperature in C */
+#define MAX_TEMP        (85)                    /**< Hottest temperature in C */
+
+/**
+ * @brief calibrate the TSC once, at module load.
+ * @return 0 on success, otherwise errno.
+ */
+int hcsr_conv_init(void);
+
+/**
+ * @brief TSC ticks to nanoseconds.
+ * @param ticks, the number of ticks.
+ * @return the time in ns.
+ */
+unsigned long long hcsr_conv_to_ns(unsigned long long);
+
+/**
+ * @brief fixed point multiplier from echo width to distance.
+ * @param temperature, the ambient temperature in C.
+ * @return mm per TSC tick, with CONV_SHIFT fraction bits.
+ */
+unsigned int hcsr_conv_mult(int);
+
+/**
+ * @brief echo width to distance.
+ * @param ticks, the echo width in TSC ticks.
+ * @param mult, the multiplier from hcsr_conv_mult.
+ * @return the distance in mm.
+ */
+static inline unsigned long long hcsr_conv_to_mm(unsigned long long ticks, unsigned int mult) {
+        return mul_u64_u32_shr(ticks, mult, CONV_SHIFT);
+}
+
+/**
+ * @brief distance to echo width.
+ * @param mm, the distance in mm.
+ * @param mult, the multiplier from hcsr_conv_mult.
+ * @return the echo width in TSC ticks.
+ */
+static inline unsigned long long hcsr_conv_to_ticks(unsigned long long mm, unsigned int mult) {
+        return div_u64(mm << CONV_SHIFT, mult);
+}
+
+#endif
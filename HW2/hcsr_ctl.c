@@ -0,0 +1,129 @@
+/**
+ * @file hcsr_ctl.c
+ * @brief Registry of hcsr04 devices and the control node acting on all of them.
+ *
+ * /dev/HCSR_ctl
+ *      GET_SNAPSHOT, latest result of every registered sensor in one call.
+ *      TRIGGER_ALL, start one round on every idle configured sensor at once.
+ * 
+ * @author Xiangyu Guo
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/fs.h>
+#include <linux/miscdevice.h>
+
+#include <linux/uaccess.h>
+#include <asm/uaccess.h>
+
+#include "defs.h"
+#include "hcsr_drv.h"
+#include "hcsr_ctl.h"
+
+#include "common.h"
+
+#define CONTROL_NAME    "HCSR_ctl"              /**< Name of the control node */
+
+static LIST_HEAD(s_dev_list);                   /**< Registered devices */
+static DEFINE_MUTEX(s_dev_list_lock);           /**< Protects s_dev_list */
+
+/**
+ * @brief fill in the latest result of every registered sensor.
+ * @param snap, storage for the snapshot.
+ */
+static void hcsr_ctl_snapshot(hcsr_snapshot_t *snap) {
+        hcsr_dev_t *devp;
+        sensor_result_t *sensor;
+
+        memset(snap, 0, sizeof(hcsr_snapshot_t));
+
+        mutex_lock(&s_dev_list_lock);
+        list_for_each_entry(devp, &s_dev_list, list) {
+                if (snap->count == HCSR_MAX_SENSORS)
+                        break;
+                sensor = &snap->sensors[snap->count++];
+                strncpy(sensor->name, devp->name, HCSR_NAME_LEN - 1);
+                hcsr_get_latest(devp, &sensor->result);
+        }
+        mutex_unlock(&s_dev_list_lock);
+}
+
+/**
+ * @brief start one round on every idle configured sensor.
+ * @return the number of sensors started.
+ */
+static int hcsr_ctl_trigger_all(void) {
+        hcsr_dev_t *devp;
+        hcsr_dev_t *started[HCSR_MAX_SENSORS];
+        int count = 0;
+        int i;
+
+        mutex_lock(&s_dev_list_lock);
+        // Take every sensor first, so the rounds start together below.
+        list_for_each_entry(devp, &s_dev_list, list) {
+                if (count == HCSR_MAX_SENSORS)
+                        break;
+                if (devp->settings.pins.trigger_pin == -1 ||
+                    devp->settings.pins.echo_pin == -1)
+                        continue;
+                // Busy ones are sampling already.
+                if (hcsr_lock(devp))
+                        continue;
+                started[count++] = devp;
+        }
+
+        for (i = 0; i < count; ++i)
+                hcsr_new_task(started[i]);
+        mutex_unlock(&s_dev_list_lock);
+
+        return count;
+}
+
+static long hcsr_ctl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg) {
+        hcsr_snapshot_t snap;
+
+        switch (cmd) {
+                case GET_SNAPSHOT:
+                        hcsr_ctl_snapshot(&snap);
+                        if (copy_to_user((void *)arg, &snap, sizeof(hcsr_snapshot_t)))
+                                return -EFAULT;
+                        return 0;
+                case TRIGGER_ALL:
+                        return hcsr_ctl_trigger_all();
+                default:
+                        return -EINVAL;
+        }
+}
+
+static const struct file_operations hcsr_ctl_fops = {
+        .owner = THIS_MODULE,
+        .unlocked_ioctl = hcsr_ctl_ioctl,
+};
+
+static struct miscdevice s_ctl_dev = {
+        .minor = MISC_DYNAMIC_MINOR,
+        .name = CONTROL_NAME,
+        .fops = &hcsr_ctl_fops,
+};
+
+int hcsr_ctl_init(void) {
+        return misc_register(&s_ctl_dev);
+}
+
+void hcsr_ctl_exit(void) {
+        misc_deregister(&s_ctl_dev);
+}
+
+void hcsr_ctl_add(hcsr_dev_t *devp) {
+        mutex_lock(&s_dev_list_lock);
+        list_add_tail(&devp->list, &s_dev_list);
+        mutex_unlock(&s_dev_list_lock);
+}
+
+void hcsr_ctl_remove(hcsr_dev_t *devp) {
+        mutex_lock(&s_dev_list_lock);
+        list_del(&devp->list);
+        mutex_unlock(&s_dev_list_lock);
+}
@@ -0,0 +1,36 @@
+/**
+ * @file hcsr_ctl.h
+ * @brief Registry of hcsr04 devices and the control node acting on all of them.
+ * 
+ * @author Xiangyu Guo
+ */
+#ifndef __HCSR_CTL_H__
+#define __HCSR_CTL_H__
+
+#include "hcsr04.h"
+
+/**
+ * @brief create the control node.
+ * @return 0 on success, otherwise errno.
+ */
+int hcsr_ctl_init(void);
+
+/**
+ * @brief remove the control node.
+ * @note every device must have been removed from the registry.
+ */
+void hcsr_ctl_exit(void);
+
+/**
+ * @brief add a device to the registry.
+ * @param devp, a valid device pointer.
+ */
+void hcsr_ctl_add(hcsr_dev_t *);
+
+/**
+ * @brief remove a device from the registry.
+ * @param devp, a valid device pointer.
+ */
+void hcsr_ctl_remove(hcsr_dev_t *);
+
+#endif
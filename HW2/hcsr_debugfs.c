@@ -0,0 +1,173 @@
+/**
+ * @file hcsr_debugfs.c
+ * @brief Latency and throughput statistics of hcsr04 devices in debugfs.
+ *
+ * /sys/kernel/debug/hcsr/<device>/
+ *      trigger_to_rise, echo_width, sample_to_queue, queue_to_read
+ *              log2 histograms in TSC cycles, "low high count" per line.
+ *      counters
+ *              results, dropped, spurious, timeouts, samples/sec.
+ *              Writing anything resets all statistics of the device.
+ *      trace_enable, trace, replay
+ *              edge trace capture and replay, see hcsr_trace.c.
+ * 
+ * @author Xiangyu Guo
+ */
+#include <linux/kernel.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/fs.h>
+
+#include <asm/div64.h>
+
+#include "defs.h"
+#include "hcsr_debugfs.h"
+#include "hcsr_trace.h"
+
+#define DEBUGFS_ROOT    "hcsr"                  /**< Directory of the driver */
+
+static struct dentry *s_root = NULL;            /**< debugfs root of the driver */
+
+/**
+ * @brief print the non-empty buckets of a histogram.
+ * @param m, the seq file.
+ * @param v, unused.
+ * @return 0.
+ */
+static int hcsr_hist_show(struct seq_file *m, void *v) {
+        hcsr_hist_t *hist = m->private;
+        unsigned int count;
+        int i;
+
+        for (i = 0; i < HIST_BUCKETS; ++i) {
+                count = atomic_read(&hist->bucket[i]);
+                if (count == 0)
+                        continue;
+                seq_printf(m, "%llu %llu %u\n", i ? 1ULL << (i - 1) : 0ULL,
+                           (1ULL << i) - 1, count);
+        }
+        return 0;
+}
+
+static int hcsr_hist_open(struct inode *inode, struct file *file) {
+        return single_open(file, hcsr_hist_show, inode->i_private);
+}
+
+static const struct file_operations hcsr_hist_fops = {
+        .owner = THIS_MODULE,
+        .open = hcsr_hist_open,
+        .read = seq_read,
+        .llseek = seq_lseek,
+        .release = single_release,
+};
+
+/**
+ * @brief reset all statistics of a device.
+ * @param perf, the statistics.
+ */
+static void hcsr_perf_reset(hcsr_perf_t *perf) {
+        struct dentry *dir = perf->dir;
+
+        memset(perf, 0, sizeof(hcsr_perf_t));
+        perf->dir = dir;
+        perf->since = ktime_get();
+}
+
+/**
+ * @brief print the counters of a device.
+ * @param m, the seq file.
+ * @param v, unused.
+ * @return 0.
+ */
+static int hcsr_counters_show(struct seq_file *m, void *v) {
+        hcsr_dev_t *devp = m->private;
+        hcsr_perf_t *perf = &devp->perf;
+        unsigned long long rate = perf->samples * NSEC_PER_SEC;
+        s64 elapsed = ktime_to_ns(ktime_sub(ktime_get(), perf->since));
+
+        if (elapsed > 0)
+                rate = div64_u64(rate, elapsed);
+
+        seq_printf(m, "results %u\n", atomic_read(&perf->results));
+        seq_printf(m, "dropped %lu\n", rec_ring_buff_dropped(devp->result_queue));
+        seq_printf(m, "spurious %u\n", atomic_read(&perf->spurious));
+        seq_printf(m, "timeouts %u\n", atomic_read(&perf->timeouts));
+        seq_printf(m, "samples %llu\n", perf->samples);
+        seq_printf(m, "samples/sec %llu\n", rate);
+        seq_printf(m, "trace_dropped %lu\n", rec_ring_buff_dropped(devp->trace.records));
+        return 0;
+}
+
+static int hcsr_counters_open(struct inode *inode, struct file *file) {
+        return single_open(file, hcsr_counters_show, inode->i_private);
+}
+
+static ssize_t hcsr_counters_write(struct file *file, const char __user *buf,
+                                   size_t count, loff_t *ppos) {
+        hcsr_dev_t *devp = ((struct seq_file *)file->private_data)->private;
+
+        hcsr_perf_reset(&devp->perf);
+        return count;
+}
+
+static const struct file_operations hcsr_counters_fops = {
+        .owner = THIS_MODULE,
+        .open = hcsr_counters_open,
+        .read = seq_read,
+        .write = hcsr_counters_write,
+        .llseek = seq_lseek,
+        .release = single_release,
+};
+
+int hcsr_debugfs_init(void) {
+        s_root = debugfs_create_dir(DEBUGFS_ROOT, NULL);
+        if (IS_ERR_OR_NULL(s_root)) {
+                // Statistics are still collected, just not shown.
+                printk(KERN_INFO "debugfs not available\n");
+                s_root = NULL;
+        }
+        return 0;
+}
+
+void hcsr_debugfs_exit(void) {
+        debugfs_remove_recursive(s_root);
+        s_root = NULL;
+}
+
+void hcsr_debugfs_add(hcsr_dev_t *devp) {
+        hcsr_perf_t *perf = &devp->perf;
+
+        perf->dir = NULL;
+        hcsr_perf_reset(perf);
+
+        if (s_root == NULL)
+                return;
+
+        perf->dir = debugfs_create_dir(devp->name, s_root);
+        if (IS_ERR_OR_NULL(perf->dir)) {
+                perf->dir = NULL;
+                return;
+        }
+
+        debugfs_create_file("trigger_to_rise", S_IRUSR, perf->dir,
+                            &perf->trigger_to_rise, &hcsr_hist_fops);
+        debugfs_create_file("echo_width", S_IRUSR, perf->dir,
+                            &perf->echo_width, &hcsr_hist_fops);
+        debugfs_create_file("sample_to_queue", S_IRUSR, perf->dir,
+                            &perf->sample_to_queue, &hcsr_hist_fops);
+        debugfs_create_file("queue_to_read", S_IRUSR, perf->dir,
+                            &perf->queue_to_read, &hcsr_hist_fops);
+        debugfs_create_file("counters", S_IRUSR | S_IWUSR, perf->dir,
+                            devp, &hcsr_counters_fops);
+        debugfs_create_file("trace_enable", S_IRUSR | S_IWUSR, perf->dir,
+                            devp, &hcsr_trace_enable_fops);
+        debugfs_create_file("trace", S_IRUSR, perf->dir,
+                            devp, &hcsr_trace_fops);
+        debugfs_create_file("replay", S_IRUSR | S_IWUSR, perf->dir,
+                            devp, &hcsr_replay_fops);
+}
+
+void hcsr_debugfs_remove(hcsr_dev_t *devp) {
+        debugfs_remove_recursive(devp->perf.dir);
+        devp->perf.dir = NULL;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file hcsr_debugfs.h
+ * @brief Latency and throughput statistics of hcsr04 devices in debugfs.
+ * 
+ * @author Xiangyu Guo
+ */
+#ifndef __HCSR_DEBUGFS_H__
+#define __HCSR_DEBUGFS_H__
+
+#include <linux/atomic.h>
+#include <linux/bitops.h>
+#include <linux/ktime.h>
+
+#include "hcsr04.h"
+
+#define HIST_BUCKETS    (40)                    /**< log2 buckets, up to 2^39 cycles */
+
+/** log2 histogram, bucket i counts values in [2^(i-1), 2^i) */
+typedef struct hcsr_hist {
+        atomic_t bucket[HIST_BUCKETS];          /**< Counts per bucket */
+} hcsr_hist_t;
+
+/** per device statistics, all latencies in TSC cycles */
+typedef struct hcsr_perf {
+        hcsr_hist_t trigger_to_rise;            /**< Trigger to echo rising edge */
+        hcsr_hist_t echo_width;                 /**< Echo pulse width */
+        hcsr_hist_t sample_to_queue;            /**< Last echo edge to result queued */
+        hcsr_hist_t queue_to_read;              /**< Result queued to read() by user */
+        atomic_t results;                       /**< Results produced */
+        atomic_t spurious;                      /**< Edges beyond two per trigger */
+        atomic_t timeouts;                      /**< Triggers without an echo */
+        unsigned long long samples;             /**< Triggers sent */
+        ktime_t since;                          /**< Start of the statistics */
+        struct dentry *dir;                     /**< debugfs directory of the device */
+} hcsr_perf_t;
+
+/**
+ * @brief count one value in a histogram.
+ * @param hist, a valid histogram.
+ * @param val, the value.
+ * @note safe to call from the isr.
+ */
+static inline void hcsr_hist_add(hcsr_hist_t *hist, unsigned long long val) {
+        atomic_inc(&hist->bucket[min(fls64(val), HIST_BUCKETS - 1)]);
+}
+
+/**
+ * @brief create the debugfs root of the driver.
+ * @return 0 on success, otherwise errno.
+ */
+int hcsr_debugfs_init(void);
+
+/**
+ * @brief remove the debugfs root of the driver.
+ */
+void hcsr_debugfs_exit(void);
+
+/**
+ * @brief reset the statistics and create the debugfs files of a device.
+ * @param devp, a valid device pointer.
+ * @note statistics work without debugfs, the files are best effort.
+ */
+void hcsr_debugfs_add(hcsr_dev_t *);
+
+/**
+ * @brief remove the debugfs files of a device.
+ * @param devp, a valid device pointer.
+ */
+void hcsr_debugfs_remove(hcsr_dev_t *);
+
+#endif
@@ -10,6 +10,7 @@
 #include <linux/gpio.h>
 #include <linux/delay.h>
 #include <linux/kthread.h>
+#include <linux/eventfd.h>
 
 #include <linux/slab.h>
 
@@ -18,12 +19,21 @@
 
 #include "hcsr_drv.h"
 #include "hcsr_config.h"
+#include "hcsr_mmap.h"
+#include "hcsr_debugfs.h"
+#include "hcsr_conv.h"
+#include "hcsr_iio.h"
+#include "hcsr_thresh.h"
+#include "hcsr_trace.h"
 
 #include "utils.h"
 
-#define HISTORY_SIZE    (5)                     /**< Sampling history size */
 #define DEFAULT_M       (4)                     /**< Default value for m */
 #define DEFAULT_DELTA   (200)                   /**< Default value for delta */
+#define DEFAULT_GUARD   (10000)                 /**< Default guard time in us */
+#define ECHO_SETUP_US   (1000)                  /**< Trigger to echo start, burst included */
+#define US_PER_CM       (58)                    /**< Echo width per cm of distance */
+#define EARLY_MIN       (3)                     /**< Fewest echoes before stopping early */
 
 /**
  * @brief: handling the echo pin interrupt.
@@ -33,13 +43,22 @@
  * @note: keep the isr as short as possible and response faster.
  */
 static irqreturn_t isr_handler(int irq, void *dev_id) {
-        unsigned long tsc = rdtsc();
+        unsigned long long tsc = rdtsc();
         sample_data_t *devp = (sample_data_t *)dev_id;
+        hcsr_dev_t *dev = container_of(devp, hcsr_dev_t, sample_result);
+        hcsr_perf_t *perf = &dev->perf;
+
+        // Edges come in rising/falling pairs, fold each pair right away.
+        if (hcsr_sample_edge(devp, tsc)) {
+                hcsr_hist_add(&perf->echo_width, tsc - devp->rise);
+                hcsr_trace_add(dev, HCSR_TRACE_EDGE, tsc, 0);
+                // Echo complete, adaptive sampling may go on.
+                wake_up(&dev->echo_wq);
+        } else {
+                hcsr_hist_add(&perf->trigger_to_rise, tsc - devp->trigger);
+                hcsr_trace_add(dev, HCSR_TRACE_EDGE, tsc, 1);
+        }
 
-        // Push the data into the device buffer.
-        devp->data[devp->count++] = tsc;
-
-        //wake_up_interruptible
         return IRQ_HANDLED;
 }
 
@@ -50,10 +69,55 @@ static irqreturn_t isr_handler(int irq, void *dev_id) {
  */
 static int hcsr_sampling_thread(void *data);
 
+/**
+ * @brief number of triggers in one round.
+ * @param devp, a valid pointer to device object.
+ * @return m, plus the outliers if the filter drops them.
+ */
+static unsigned int hcsr_triggers(hcsr_dev_t *);
+
+/**
+ * @brief account the edges of one round against the triggers sent.
+ * @param devp, a valid pointer to device object.
+ * @param triggers, the number of triggers sent in the round.
+ */
+static void hcsr_count_edges(hcsr_dev_t *, unsigned int);
+
+/**
+ * @brief wait between two triggers of a round.
+ * @param devp, a valid pointer to device object.
+ * @param base, the edge count read right before the trigger.
+ * @param delta, the fixed interval in ms.
+ * @note adaptive mode triggers again a guard time after the echo, falling
+ *       back to the fixed interval when the echo times out.
+ */
+static void hcsr_wait_echo(hcsr_dev_t *, unsigned int, int);
+
+/**
+ * @brief record the trigger rate of the last round.
+ * @param devp, a valid pointer to device object.
+ * @param triggers, the number of triggers sent in the round.
+ * @param elapsed, the duration of the round.
+ */
+static void hcsr_update_rate(hcsr_dev_t *, unsigned int, ktime_t);
+
+/**
+ * @brief check whether the round can stop before m triggers.
+ * @param devp, a valid pointer to device object.
+ * @return 1 when the echoes so far agree within the tolerance, otherwise 0.
+ */
+static int hcsr_round_done(hcsr_dev_t *);
+
+/**
+ * @brief signal the bound eventfd on every Nth result.
+ * @param devp, a valid pointer to device object.
+ */
+static void hcsr_eventfd_notify(hcsr_dev_t *);
+
 /**
  * @brief compute the distance.
  * @param devp, a valid pointer to device object.
- * @return averaged result in centimeter without outlier.
+ * @return filtered result in millimeter.
  */
 static unsigned long long hcsr_get_pulse_width(hcsr_dev_t *);
 
@@ -67,26 +131,129 @@ int hcsr_lock(hcsr_dev_t *devp) {
 
 void hcsr_unlock(hcsr_dev_t *devp) {
         atomic_inc(&devp->available);
+        // Readers below the watermark may start their own task now.
+        wake_up_interruptible(&devp->result_wq);
+}
+
+int hcsr_lock_wait(hcsr_dev_t *devp, int nonblock) {
+        while (hcsr_lock(devp)) {
+                // A nonstop round never completes.
+                if (nonblock || devp->settings.endless)
+                        return -EBUSY;
+                if (wait_event_interruptible(devp->result_wq,
+                                atomic_read(&devp->available) > 0 ||
+                                devp->settings.endless))
+                        return -ERESTARTSYS;
+        }
+        return 0;
+}
+
+unsigned int hcsr_request_join(hcsr_dev_t *devp) {
+        // Read first, a round finishing right now must not count for us.
+        unsigned int req = ACCESS_ONCE(devp->rounds) + 1;
+
+        smp_rmb();
+        // None in flight, start it.
+        if (!hcsr_lock(devp)) {
+                hcsr_new_task(devp);
+                return req;
+        }
+
+        // The round in flight may have counted already, the thread runs
+        // one more unless it unlocked meanwhile and we get the device.
+        atomic_set(&devp->pending, 1);
+        smp_mb__after_atomic();
+        if (!hcsr_lock(devp)) {
+                atomic_set(&devp->pending, 0);
+                hcsr_new_task(devp);
+        }
+
+        return req;
+}
+
+int hcsr_request_done(hcsr_dev_t *devp, unsigned int req) {
+        return (int)(ACCESS_ONCE(devp->rounds) - req) >= 0;
 }
 
 int hcsr_new_task(hcsr_dev_t *devp) {
         // start a new sampling by starting a new thread
         devp->job_done = 0;
+        // Don't wait for the idle poll, start right away.
+        wake_up_process(devp->tsk);
         return 0;
 }
 
-int hcsr_reallocate(hcsr_dev_t *devp, int m) {
-        unsigned long long *data = kmalloc(sizeof(unsigned long long) * m * 2,
-                                           GFP_KERNEL);
-        if (data == NULL) {
-                printk(KERN_ALERT "Out of memory!\n");
-                return -ENOMEM;
+int hcsr_eventfd_bind(hcsr_dev_t *devp, struct file *owner, eventfd_setting_t *setting) {
+        struct eventfd_ctx *ctx = NULL;
+        struct eventfd_ctx *old;
+
+        if (setting->fd >= 0) {
+                ctx = eventfd_ctx_fdget(setting->fd);
+                if (IS_ERR(ctx))
+                        return PTR_ERR(ctx);
+        }
+
+        spin_lock(&devp->eventfd.lock);
+        old = devp->eventfd.ctx;
+        devp->eventfd.ctx = ctx;
+        devp->eventfd.owner = ctx ? owner : NULL;
+        devp->eventfd.every = max(setting->every, 1U);
+        devp->eventfd.count = 0;
+        spin_unlock(&devp->eventfd.lock);
+
+        if (old)
+                eventfd_ctx_put(old);
+        return 0;
+}
+
+void hcsr_eventfd_unbind(hcsr_dev_t *devp, struct file *owner) {
+        struct eventfd_ctx *old = NULL;
+
+        spin_lock(&devp->eventfd.lock);
+        if (owner == NULL || devp->eventfd.owner == owner) {
+                old = devp->eventfd.ctx;
+                devp->eventfd.ctx = NULL;
+                devp->eventfd.owner = NULL;
         }
-        kfree(devp->sample_result.data);
-        devp->sample_result.data = data;
+        spin_unlock(&devp->eventfd.lock);
+
+        if (old)
+                eventfd_ctx_put(old);
+}
+
+void hcsr_get_latest(hcsr_dev_t *devp, result_info_t *res) {
+        unsigned int seq;
+
+        do {
+                seq = read_seqcount_begin(&devp->latest_seq);
+                *res = devp->latest;
+        } while (read_seqcount_retry(&devp->latest_seq, seq));
+}
+
+int hcsr_get_cached(hcsr_dev_t *devp, result_info_t *res, unsigned int max_age) {
+        hcsr_get_latest(devp, res);
+        if (res->timestamp == 0)
+                return -EAGAIN;
+
+        if (hcsr_conv_to_ns(rdtsc() - res->timestamp) > (unsigned long long)max_age * NSEC_PER_MSEC)
+                return -EAGAIN;
         return 0;
 }
 
+int hcsr_get_results(hcsr_dev_t *devp, result_info_t *results, unsigned int n) {
+        int ret;
+
+        mutex_lock(&devp->queue_lock);
+        ret = rec_ring_buff_get_bulk(devp->result_queue, results, n);
+        mutex_unlock(&devp->queue_lock);
+
+        return ret;
+}
+
+int hcsr_result_ready(hcsr_dev_t *devp) {
+        return rec_ring_buff_count(devp->result_queue) >= devp->settings.watermark;
+}
+
 int hcsr_isr_init(hcsr_dev_t *devp) {
         // Trigger and waiting for the response.
         devp->irq_no = gpio_to_irq(hcsr04_shield_to_gpio(devp->settings.pins.echo_pin));
@@ -106,11 +273,15 @@ int hcsr_isr_exit(hcsr_dev_t *devp) {
 }
 
 int hcsr_init_one(struct hcsr_dev *devp) {
+        filter_setting_t filter;
+        int ret;
+
         printk(KERN_ALERT "Found the device -- %s\n", devp->name);
         printk(KERN_INFO "Creating %s\n", devp->name);
 
         // Initialized device lock.
         atomic_set(&devp->available, 1);
+        atomic_set(&devp->pending, 0);
         atomic_set(&devp->settings.most_recent, 0);
 
         // Initialized default m and delta.
@@ -126,108 +297,231 @@ int hcsr_init_one(struct hcsr_dev *devp) {
         devp->on_complete.notify = NULL;
 
         devp->irq_no = 0;
+        devp->indio_dev = NULL;
         devp->job_done = 1;
         devp->settings.endless = 0;
+        devp->settings.watermark = 1;
+        devp->settings.adaptive = 0;
+        devp->settings.max_range = MAX_RANGE;
+        devp->settings.guard = DEFAULT_GUARD;
+        devp->settings.rate = 0;
+        devp->settings.tolerance = 0;
+        devp->settings.temperature = DEFAULT_TEMP;
+        devp->settings.mm_mult = hcsr_conv_mult(DEFAULT_TEMP);
+
+        // Initialized default filter.
+        filter.type = HCSR_FILTER_AVERAGE;
+        filter.trim = 1;
+        filter.alpha = DEFAULT_ALPHA;
+        filter.beta = DEFAULT_BETA;
+        hcsr_filter_init(&devp->filter, &filter);
 
         // Initialized the result_queue buff.
-        devp->result_queue = ring_buff_init(HISTORY_SIZE, kfree); 
+        mutex_init(&devp->queue_lock);
+        init_waitqueue_head(&devp->result_wq);
+        devp->result_queue = rec_ring_buff_init(HISTORY_SIZE, sizeof(result_info_t));
         if (devp->result_queue == NULL)
                 return -ENOMEM;
 
-        // Initialized the sample_result buff.
-        devp->sample_result.data = kmalloc(sizeof(unsigned long long) * 
-                                        devp->settings.params.m * 2, GFP_KERNEL);
-        if (devp->sample_result.data == NULL)
-                return -ENOMEM;
+        // Initialized the eventfd binding.
+        spin_lock_init(&devp->eventfd.lock);
+        devp->eventfd.ctx = NULL;
+        devp->eventfd.owner = NULL;
+
+        // Initialized the threshold events, no limit set.
+        ret = hcsr_thresh_init(devp);
+        if (ret)
+                goto free_queue;
+
+        // Initialized the shared result ring for mmap readers.
+        init_waitqueue_head(&devp->mmap_wq);
+        init_waitqueue_head(&devp->echo_wq);
+        ret = hcsr_mmap_init(devp);
+        if (ret)
+                goto free_thresh;
+
+        // Initialized the latest result.
+        seqcount_init(&devp->latest_seq);
+        memset(&devp->latest, 0, sizeof(result_info_t));
+        devp->rounds = 0;
+
+        // Initialized the sample_result aggregate.
+        devp->sample_result.count = 0;
+        hcsr_stats_reset(&devp->sample_result.stats);
+
+        // Initialized the edge trace, capture off.
+        ret = hcsr_trace_init(devp);
+        if (ret)
+                goto free_mmap;
+
+        // Initialized the statistics.
+        hcsr_debugfs_add(devp);
 
         // Initialized the sampling thread
         printk(KERN_INFO "Going to run the thread\n");
         devp->tsk = kthread_run(hcsr_sampling_thread, devp, "sampling thread");
         if (IS_ERR(devp->tsk)) {
                 printk(KERN_INFO "kthread failed\n");
+                devp->tsk = NULL;
                 // Create a child process failed.
-                return -ECHILD;
+                ret = -ECHILD;
+                goto free_debugfs;
         }
 
         printk(KERN_INFO "Adding %s\n", devp->name);
 
         return 0;
+
+free_debugfs:
+        hcsr_debugfs_remove(devp);
+        hcsr_trace_fini(devp);
+free_mmap:
+        hcsr_mmap_fini(devp);
+free_thresh:
+        hcsr_thresh_fini(devp);
+free_queue:
+        rec_ring_buff_fini(devp->result_queue);
+        devp->result_queue = NULL;
+        return ret;
+}
+
+void hcsr_stop_one(struct hcsr_dev *devp) {
+        if (devp->tsk == NULL)
+                return;
+
+        // No nonstop round from now on.
+        devp->settings.endless = 0;
+
+        // Hold the device, the thread is idle and nobody wakes it up again.
+        wait_event(devp->result_wq, !hcsr_lock(devp));
+
+        // Exit the thread.
+        kthread_stop(devp->tsk);
+        devp->tsk = NULL;
 }
 
 void hcsr_fini_one(struct hcsr_dev *devp) {
+        // Stopped already when a front-end had to go first.
+        hcsr_stop_one(devp);
+
         // Remove isr and irq_no
         hcsr_isr_exit(devp);
 
         // Release the gpio setting.
         hcsr04_config_fini(&devp->settings.pins);
 
-        devp->settings.endless = 0;
+        // Release the result_queue buff.
+        rec_ring_buff_fini(devp->result_queue);
 
-        // Exit the thread.
-        kthread_stop(devp->tsk);
+        // Release the shared result ring.
+        hcsr_mmap_fini(devp);
 
-        // Release the sample_result buff.
-        kfree(devp->sample_result.data);
+        // Drop the eventfd binding.
+        hcsr_eventfd_unbind(devp, NULL);
 
-        // Release the result_queue buff.
-        ring_buff_fini(devp->result_queue);
+        // Release the threshold events.
+        hcsr_thresh_fini(devp);
+
+        // Remove the statistics.
+        hcsr_debugfs_remove(devp);
+
+        // Release the edge trace, nobody reads it any more.
+        hcsr_trace_fini(devp);
 }
 
 static int hcsr_sampling_thread(void *data) {
         int m;
         int delta;
-        int trigger_pin;
+        unsigned int triggers;
+        unsigned int base;
         hcsr_dev_t *devp = (hcsr_dev_t *)data;
-        result_info_t *res = NULL;
+        result_info_t res;
+        ktime_t start;
 
         while (!kthread_should_stop()) {
+                set_current_state(TASK_INTERRUPTIBLE);
                 if (devp->job_done) {
-                        msleep(100);
+                        // Woken up early by hcsr_new_task.
+                        schedule_timeout(msecs_to_jiffies(100));
                         continue;
                 }
+                __set_current_state(TASK_RUNNING);
                 // save parameters.
                 delta = devp->settings.params.delta;
-                trigger_pin = hcsr04_shield_to_gpio(devp->settings.pins.trigger_pin);
 
                 do {
-                        m = devp->settings.params.m;
-                        // clear the sampling buffer before sampling.
+                        triggers = m = hcsr_triggers(devp);
+                        // clear the sampling aggregate before sampling.
                         devp->sample_result.count = 0;
+                        devp->sample_result.fall = 0;
+                        hcsr_stats_reset(&devp->sample_result.stats);
+                        hcsr_trace_add(devp, HCSR_TRACE_ROUND, rdtsc(), devp->rounds + 1);
                         // tell the compiler don't optimize the above code using Out of Order Execution.
                         barrier();
 
                         //printk(KERN_INFO "m %d, delta %d\n", m, delta);
                         // Now we can safely start trigger m times.
+                        start = ktime_get();
                         while (m > 0) {
-                                gpio_set_value_cansleep(trigger_pin, 1);
-                                udelay(10);
-                                gpio_set_value_cansleep(trigger_pin, 0);
-                                msleep(delta);
+                                // Edges of earlier triggers don't end this wait.
+                                base = ACCESS_ONCE(devp->sample_result.count);
+                                devp->sample_result.trigger = rdtsc();
+                                hcsr_trace_add(devp, HCSR_TRACE_TRIGGER,
+                                               devp->sample_result.trigger, triggers - m + 1);
+                                hcsr04_trigger(&devp->settings.pins);
+                                hcsr_wait_echo(devp, base, delta);
                                 //printk(KERN_INFO "sampling %d\n", m);
                                 m--;
+                                // m is only the upper bound.
+                                if (m > 0 && hcsr_round_done(devp))
+                                        break;
                         }
+                        triggers -= m;
+                        hcsr_update_rate(devp, triggers, ktime_sub(ktime_get(), start));
 
                         //printk(KERN_ALERT "Total interrupts %u\n", devp->sample_result.count);
                         // similary, we don't want the below code get executed before the sampling completed.
                         barrier();
+                        hcsr_count_edges(devp, triggers);
 
                         // Collect the tsc in ISR and compute here.
-                        res = kmalloc(sizeof(result_info_t), GFP_KERNEL);
-                        if (res == NULL) {
-                                break;
-                        }
-
-                        res->measurement = hcsr_get_pulse_width(devp);
-                        res->timestamp = rdtsc();
-
-                        //printk(KERN_INFO "Result: %llu\n", res->measurement);
+                        res.measurement = hcsr_get_pulse_width(devp);
+                        res.timestamp = rdtsc();
+                        res.variance = hcsr_conv_to_mm(hcsr_conv_to_mm(
+                                        hcsr_stats_variance(&devp->sample_result.stats),
+                                        devp->settings.mm_mult), devp->settings.mm_mult);
+                        res.samples = triggers;
+                        res.reserved = 0;
+                        hcsr_trace_add(devp, HCSR_TRACE_RESULT, res.timestamp,
+                                       (unsigned int)res.measurement);
+                        // Every echo of the round timed out, nothing to measure from.
+                        if (devp->sample_result.fall)
+                                hcsr_hist_add(&devp->perf.sample_to_queue,
+                                              res.timestamp - devp->sample_result.fall);
+                        atomic_inc(&devp->perf.results);
+
+                        //printk(KERN_INFO "Result: %llu\n", res.measurement);
 
                         // After sampling, we need to add to the result_queue buff.
-                        ring_buff_put(devp->result_queue, res);
-                        atomic_set(&devp->settings.most_recent, res->measurement);
+                        rec_ring_buff_put(devp->result_queue, &res);
+                        hcsr_mmap_put(devp, &res);
+                        atomic_set(&devp->settings.most_recent, res.measurement);
+                        write_seqcount_begin(&devp->latest_seq);
+                        devp->latest = res;
+                        write_seqcount_end(&devp->latest_seq);
+                        // Complete the request, every waiter gets a copy.
+                        smp_wmb();
+                        devp->rounds++;
+                        // Waiters check the watermark and their request.
+                        wake_up_interruptible(&devp->mmap_wq);
+                        wake_up_interruptible(&devp->result_wq);
+                        hcsr_eventfd_notify(devp);
+                        hcsr_iio_poll(devp);
+                        // Crossings have their own waiters.
+                        hcsr_thresh_update(devp, &res);
                         // Do we need to notify someone?
                         if (devp->on_complete.notify != NULL) {
-                                devp->on_complete.notify((unsigned long)res->measurement);
+                                devp->on_complete.notify((unsigned long)res.measurement);
                         }
                 } while (devp->settings.endless);
 
@@ -235,38 +529,93 @@ static int hcsr_sampling_thread(void *data) {
 
                 // unlock device
                 hcsr_unlock(devp);
+
+                // A request came in too late for this round, run one more.
+                smp_mb();
+                if (atomic_xchg(&devp->pending, 0) && !hcsr_lock(devp))
+                        devp->job_done = 0;
         }
         do_exit(0);
         return 0;
 }
 
-static unsigned long long hcsr_get_pulse_width(hcsr_dev_t *devp) {
-        int i;
-        unsigned long long sum = 0;
-        unsigned long long large = 0;
-        unsigned long long small = UINT_MAX;
-
-        // Go through the sampling result buffer.
-        for (i = 0; i < devp->settings.params.m * 2; i+=2) {
-                unsigned long long diff = devp->sample_result.data[i + 1] - 
-                                          devp->sample_result.data[i];
-                if (diff < 0) {
-                        printk(KERN_INFO "Something went wrong\n");
-                        return 0;
-                }
-                //printk(KERN_INFO "diff %llu\n", diff);
-                large = max(large, diff);
-                small = min(small, diff);
-                sum += diff;
+static unsigned int hcsr_triggers(hcsr_dev_t *devp) {
+        // params.m always has room for the outliers of the average filter.
+        return devp->settings.params.m - NUM_OF_OUTLIER +
+               hcsr_filter_outliers(&devp->filter);
+}
+
+static void hcsr_count_edges(hcsr_dev_t *devp, unsigned int triggers) {
+        unsigned int edges = devp->sample_result.count;
+
+        devp->perf.samples += triggers;
+        triggers *= 2;
+        if (edges > triggers)
+                atomic_add(edges - triggers, &devp->perf.spurious);
+        else
+                atomic_add((triggers - edges) / 2, &devp->perf.timeouts);
+}
+
+static void hcsr_wait_echo(hcsr_dev_t *devp, unsigned int base, int delta) {
+        ktime_t start = ktime_get();
+        ktime_t timeout;
+        s64 elapsed;
+
+        if (!devp->settings.adaptive) {
+                msleep(delta);
+                return;
+        }
+
+        // The farthest echo still in range is over by then.
+        timeout = ns_to_ktime((u64)(ECHO_SETUP_US + devp->settings.max_range * US_PER_CM) *
+                              NSEC_PER_USEC);
+        if (wait_event_hrtimeout(devp->echo_wq,
+                                 ACCESS_ONCE(devp->sample_result.count) - base >= 2,
+                                 timeout)) {
+                // Nothing in range, a late echo may still be on its way.
+                elapsed = ktime_to_ms(ktime_sub(ktime_get(), start));
+                if (elapsed < delta)
+                        msleep(delta - elapsed);
+                return;
         }
-        //printk(KERN_INFO "large: %llu small: %llu sum %llu\n", large, small, sum);
-        // Remove outlier.
-        sum -= large;
-        sum -= small;
 
-        do_div(sum, (devp->settings.params.m - NUM_OF_OUTLIER));
-        do_div(sum, 400);
-        do_div(sum, 58);
+        // Let the ringing and multipath echoes die out.
+        usleep_range(devp->settings.guard, devp->settings.guard + 100);
+}
+
+static void hcsr_update_rate(hcsr_dev_t *devp, unsigned int triggers, ktime_t elapsed) {
+        s64 ns = ktime_to_ns(elapsed);
+
+        if (ns <= 0)
+                return;
+        devp->settings.rate = div64_u64((u64)triggers * 1000 * NSEC_PER_SEC, ns);
+}
+
+static int hcsr_round_done(hcsr_dev_t *devp) {
+        unsigned int tolerance = devp->settings.tolerance;
+
+        if (tolerance == 0)
+                return 0;
+
+        // The average filter still drops its outliers afterwards.
+        return hcsr_stats_converged(&devp->sample_result.stats,
+                                    hcsr_conv_to_ticks(tolerance, devp->settings.mm_mult),
+                                    EARLY_MIN + hcsr_filter_outliers(&devp->filter));
+}
+
+static void hcsr_eventfd_notify(hcsr_dev_t *devp) {
+        spin_lock(&devp->eventfd.lock);
+        if (devp->eventfd.ctx && ++devp->eventfd.count >= devp->eventfd.every) {
+                devp->eventfd.count = 0;
+                eventfd_signal(devp->eventfd.ctx, 1);
+        }
+        spin_unlock(&devp->eventfd.lock);
+}
+
+static unsigned long long hcsr_get_pulse_width(hcsr_dev_t *devp) {
+        unsigned long long sum;
+
+        sum = hcsr_filter_apply(&devp->filter, &devp->sample_result.stats);
 
-        return sum;
+        return hcsr_conv_to_mm(sum, devp->settings.mm_mult);
 }
@@ -23,6 +23,31 @@ int hcsr_lock(hcsr_dev_t *);
  */
 void hcsr_unlock(hcsr_dev_t *);
 
+/**
+ * @brief wait for the round in flight to complete, then lock the device.
+ * @param devp, a valid device pointer.
+ * @param nonblock, fail right away instead of waiting.
+ * @return 0, successfully get the lock; -EBUSY if the device samples
+ *         nonstop or nonblock is set; -ERESTARTSYS on a signal.
+ */
+int hcsr_lock_wait(hcsr_dev_t *, int);
+
+/**
+ * @brief attach to the measurement request in flight, start one if idle.
+ * @param devp, a valid device pointer.
+ * @note a request racing with the end of a round gets one more round.
+ * @return the request, to pass to hcsr_request_done.
+ */
+unsigned int hcsr_request_join(hcsr_dev_t *);
+
+/**
+ * @brief check whether a request has completed.
+ * @param devp, a valid device pointer.
+ * @param req, the request returned by hcsr_request_join.
+ * @return 1 when its result is in, hcsr_get_latest has it; otherwise 0.
+ */
+int hcsr_request_done(hcsr_dev_t *, unsigned int);
+
 /**
  * @brief create a new sampling task.
  * @param devp, a valid device pointer.
@@ -31,12 +56,52 @@ void hcsr_unlock(hcsr_dev_t *);
 int hcsr_new_task(hcsr_dev_t *);
 
 /**
- * @brief reallocate the sampling buffer
- * @param devp, a valid pointer to device object.
- * @param m, new buffer size.
- * @return 0 on success, otherwise failed.
+ * @brief bind an eventfd signaled as results are queued, replacing the old one.
+ * @param devp, a valid device pointer.
+ * @param owner, the file binding it, unbound again when it is released.
+ * @param setting, the eventfd and how often to signal it.
+ * @return 0, on success; otherwise errno.
+ */
+int hcsr_eventfd_bind(hcsr_dev_t *, struct file *, eventfd_setting_t *);
+
+/**
+ * @brief unbind the eventfd, if the file bound it.
+ * @param devp, a valid device pointer.
+ * @param owner, the file, NULL unbinds unconditionally.
+ */
+void hcsr_eventfd_unbind(hcsr_dev_t *, struct file *);
+
+/**
+ * @brief copy the latest result of the device.
+ * @param devp, a valid device pointer.
+ * @param res, storage for the result, timestamp 0 if there is none yet.
+ */
+void hcsr_get_latest(hcsr_dev_t *, result_info_t *);
+
+/**
+ * @brief copy the latest result of the device if it is young enough.
+ * @param devp, a valid device pointer.
+ * @param res, storage for the result.
+ * @param max_age, the oldest acceptable result in ms.
+ * @return 0, on success; -EAGAIN if there is no such result.
  */
-int hcsr_reallocate(hcsr_dev_t *, int);
+int hcsr_get_cached(hcsr_dev_t *, result_info_t *, unsigned int);
+
+/**
+ * @brief take the oldest results out of the result queue.
+ * @param devp, a valid device pointer.
+ * @param results, storage for the results.
+ * @param n, the capacity of the storage in results.
+ * @return the number of results taken (0 on empty); otherwise errno.
+ */
+int hcsr_get_results(hcsr_dev_t *, result_info_t *, unsigned int);
+
+/**
+ * @brief enough results queued to wake up the readers.
+ * @param devp, a valid device pointer.
+ * @return 1, at least watermark results are queued; 0 otherwise.
+ */
+int hcsr_result_ready(hcsr_dev_t *);
 
 /**
  * @brief initialize the interrupt service routine.
@@ -52,6 +117,13 @@ int hcsr_isr_exit(hcsr_dev_t *);
 
 int hcsr_init_one(struct hcsr_dev *devp);
 
+/**
+ * @brief stop the sampling thread, no round runs afterwards.
+ * @param devp, a valid pointer to device object.
+ * @note call before removing what the thread feeds, e.g. the iio device.
+ */
+void hcsr_stop_one(struct hcsr_dev *devp);
+
 void hcsr_fini_one(struct hcsr_dev *devp);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,186 @@
+/**
+ * @file hcsr_filter.c
+ * @brief Filters turning the pulse widths of one round into a result.
+ * 
+ * @author Xiangyu Guo
+ */
+#include <linux/kernel.h>
+#include <linux/sort.h>
+
+#include <asm/div64.h>
+
+#include "defs.h"
+#include "hcsr_filter.h"
+
+/**
+ * @brief compare two pulse widths, for sort().
+ * @param a, pointer to the first width.
+ * @param b, pointer to the second width.
+ * @return negative, zero or positive like memcmp.
+ */
+static int hcsr_filter_cmp(const void *a, const void *b) {
+        unsigned long long x = *(const unsigned long long *)a;
+        unsigned long long y = *(const unsigned long long *)b;
+
+        if (x < y)
+                return -1;
+        return x > y;
+}
+
+/**
+ * @brief average the pulse widths after dropping the smallest and largest.
+ * @param stats, the aggregate of the round.
+ * @return the average without outlier.
+ */
+static unsigned long long hcsr_filter_average(const sample_stats_t *stats) {
+        unsigned long long sum = stats->sum;
+
+        //printk(KERN_INFO "large: %llu small: %llu sum %llu\n", stats->max, stats->min, sum);
+        // Too few to remove outlier.
+        if (stats->count <= NUM_OF_OUTLIER) {
+                do_div(sum, stats->count);
+                return sum;
+        }
+        // Remove outlier.
+        sum -= stats->max;
+        sum -= stats->min;
+
+        do_div(sum, stats->count - NUM_OF_OUTLIER);
+        return sum;
+}
+
+/**
+ * @brief average the sorted pulse widths between trim and n - trim.
+ * @param widths, sorted pulse widths.
+ * @param n, the number of pulse widths.
+ * @param trim, widths dropped at each end.
+ * @return the trimmed mean, the median if nothing is left.
+ */
+static unsigned long long hcsr_filter_trimmed(unsigned long long *widths,
+                                              unsigned int n, unsigned int trim) {
+        unsigned int i;
+        unsigned long long sum = 0;
+
+        if (2 * trim >= n)
+                return widths[n / 2];
+
+        for (i = trim; i < n - trim; ++i)
+                sum += widths[i];
+
+        do_div(sum, n - 2 * trim);
+        return sum;
+}
+
+/**
+ * @brief feed one measurement to the alpha-beta tracker.
+ * @param filter, a valid pointer to the filter object.
+ * @param z, the measured pulse width.
+ * @return the tracked pulse width.
+ */
+static unsigned long long hcsr_filter_track(hcsr_filter_t *filter, unsigned long long z) {
+        long long pred;
+        long long res;
+
+        if (!filter->primed) {
+                filter->x = (long long)z * HCSR_FILTER_ONE;
+                filter->v = 0;
+                filter->primed = 1;
+                return z;
+        }
+
+        // Predict one result ahead, then correct by the residual.
+        pred = filter->x + filter->v;
+        res = (long long)z * HCSR_FILTER_ONE - pred;
+        filter->x = pred + div_s64(res * filter->setting.alpha, HCSR_FILTER_ONE);
+        filter->v += div_s64(res * filter->setting.beta, HCSR_FILTER_ONE);
+
+        if (filter->x < 0)
+                filter->x = 0;
+        return div_s64(filter->x, HCSR_FILTER_ONE);
+}
+
+void hcsr_stats_reset(sample_stats_t *stats) {
+        stats->count = 0;
+        stats->sum = 0;
+        stats->min = ULLONG_MAX;
+        stats->max = 0;
+        stats->mean = 0;
+        stats->m2 = 0;
+}
+
+void hcsr_stats_add(sample_stats_t *stats, unsigned long long width) {
+        long long delta;
+
+        stats->window[stats->count % SAMPLE_WINDOW] = width;
+        stats->count++;
+        stats->sum += width;
+        stats->min = min(stats->min, width);
+        stats->max = max(stats->max, width);
+
+        // Welford, the mean moves toward width so m2 never goes down.
+        delta = (long long)width - stats->mean;
+        stats->mean += div_s64(delta, stats->count);
+        stats->m2 += delta * ((long long)width - stats->mean);
+}
+
+unsigned long long hcsr_stats_variance(const sample_stats_t *stats) {
+        if (stats->count < 2)
+                return 0;
+
+        return div64_u64(stats->m2, stats->count - 1);
+}
+
+int hcsr_stats_converged(const sample_stats_t *stats, unsigned long long tolerance,
+                         unsigned int min_count) {
+        if (stats->count < max(min_count, 2U))
+                return 0;
+
+        // 2 * sqrt(variance / count) <= tolerance, without the sqrt.
+        return 4 * hcsr_stats_variance(stats) <= tolerance * tolerance * stats->count;
+}
+
+int hcsr_filter_validate(const filter_setting_t *setting) {
+        if (setting->type >= HCSR_FILTER_MAX)
+                return -EINVAL;
+
+        if (setting->type == HCSR_FILTER_TRACKER &&
+            (setting->alpha == 0 || setting->alpha > HCSR_FILTER_ONE ||
+             setting->beta > HCSR_FILTER_ONE))
+                return -EINVAL;
+
+        return 0;
+}
+
+void hcsr_filter_init(hcsr_filter_t *filter, const filter_setting_t *setting) {
+        filter->setting = *setting;
+        filter->x = 0;
+        filter->v = 0;
+        filter->primed = 0;
+}
+
+unsigned int hcsr_filter_outliers(const hcsr_filter_t *filter) {
+        return filter->setting.type == HCSR_FILTER_AVERAGE ? NUM_OF_OUTLIER : 0;
+}
+
+unsigned long long hcsr_filter_apply(hcsr_filter_t *filter, sample_stats_t *stats) {
+        unsigned long long *widths = stats->window;
+        unsigned int n = min_t(unsigned int, stats->count, SAMPLE_WINDOW);
+
+        if (n == 0)
+                return 0;
+
+        if (filter->setting.type == HCSR_FILTER_AVERAGE)
+                return hcsr_filter_average(stats);
+
+        sort(widths, n, sizeof(unsigned long long), hcsr_filter_cmp, NULL);
+
+        switch (filter->setting.type) {
+                case HCSR_FILTER_TRIMMED:
+                        return hcsr_filter_trimmed(widths, n, filter->setting.trim);
+                case HCSR_FILTER_TRACKER:
+                        return hcsr_filter_track(filter, widths[n / 2]);
+                case HCSR_FILTER_MEDIAN:
+                default:
+                        return widths[n / 2];
+        }
+}
@@ -0,0 +1,95 @@
+/**
+ * @file hcsr_filter.h
+ * @brief Filters turning the pulse widths of one round into a result.
+ * 
+ * @author Xiangyu Guo
+ */
+#ifndef __HCSR_FILTER_H__
+#define __HCSR_FILTER_H__
+
+#include "common.h"
+
+#define SAMPLE_WINDOW   (16)                    /**< Latest widths kept for median/trimmed */
+#define DEFAULT_ALPHA   (HCSR_FILTER_ONE / 2)   /**< Default tracker position gain */
+#define DEFAULT_BETA    (HCSR_FILTER_ONE / 8)   /**< Default tracker velocity gain */
+
+/** Running aggregate of the pulse widths in one round */
+typedef struct sample_stats {
+        unsigned int count;                     /**< Number of pulse widths */
+        unsigned long long sum;                 /**< Sum of pulse widths */
+        unsigned long long min;                 /**< Smallest pulse width */
+        unsigned long long max;                 /**< Largest pulse width */
+        long long mean;                         /**< Running mean (Welford) */
+        unsigned long long m2;                  /**< Sum of squared deviations (Welford) */
+        unsigned long long window[SAMPLE_WINDOW]; /**< Latest pulse widths */
+} sample_stats_t;
+
+typedef struct hcsr_filter {
+        filter_setting_t setting;               /**< Selected filter */
+        long long x;                            /**< Tracker position, scaled by HCSR_FILTER_ONE */
+        long long v;                            /**< Tracker velocity per result, scaled */
+        int primed;                             /**< Tracker has seen a result */
+} hcsr_filter_t;
+
+/**
+ * @brief start a new round.
+ * @param stats, a valid pointer to the aggregate.
+ */
+void hcsr_stats_reset(sample_stats_t *);
+
+/**
+ * @brief add one pulse width to the aggregate, constant time and memory.
+ * @param stats, a valid pointer to the aggregate.
+ * @param width, the pulse width.
+ * @note safe to call from the isr.
+ */
+void hcsr_stats_add(sample_stats_t *, unsigned long long);
+
+/**
+ * @brief sample variance of the pulse widths so far.
+ * @param stats, a valid pointer to the aggregate.
+ * @return the variance in squared pulse width units, 0 below two widths.
+ */
+unsigned long long hcsr_stats_variance(const sample_stats_t *);
+
+/**
+ * @brief check whether the mean of the pulse widths is known well enough.
+ * @param stats, a valid pointer to the aggregate.
+ * @param tolerance, half width of the 95% confidence interval, pulse width units.
+ * @param min_count, the fewest widths to trust the variance with.
+ * @return 1 when the interval is within tolerance, otherwise 0.
+ */
+int hcsr_stats_converged(const sample_stats_t *, unsigned long long, unsigned int);
+
+/**
+ * @brief validate a filter setting.
+ * @param setting, a valid pointer to the filter setting.
+ * @return 0 on success, otherwise errno.
+ */
+int hcsr_filter_validate(const filter_setting_t *);
+
+/**
+ * @brief select a filter and reset its state.
+ * @param filter, a valid pointer to the filter object.
+ * @param setting, a validated filter setting.
+ */
+void hcsr_filter_init(hcsr_filter_t *, const filter_setting_t *);
+
+/**
+ * @brief samples to drop before the average filter, taken on top of m.
+ * @param filter, a valid pointer to the filter object.
+ * @return number of extra samples per result.
+ */
+unsigned int hcsr_filter_outliers(const hcsr_filter_t *);
+
+/**
+ * @brief filter the pulse widths of one round.
+ * @param filter, a valid pointer to the filter object.
+ * @param stats, the aggregate of the round, its window is reordered.
+ * @return the filtered pulse width, 0 if the round is empty.
+ * @note the average filter uses every width of the round, the order
+ *       statistics only the latest SAMPLE_WINDOW widths.
+ */
+unsigned long long hcsr_filter_apply(hcsr_filter_t *, sample_stats_t *);
+
+#endif
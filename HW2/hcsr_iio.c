@@ -0,0 +1,217 @@
+/**
+ * @file hcsr_iio.c
+ * @brief Industrial I/O front-end of hcsr04 devices.
+ *
+ * One iio device per hcsr04 device:
+ *      in_distance_raw, a fresh measurement in mm (in_distance_scale to m).
+ *      scan elements distance (u32) and timestamp, kfifo buffer.
+ *      trigger <device>-dev<id>, fired after every sampling round.
+ * 
+ * @author Xiangyu Guo
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/interrupt.h>
+
+#include <linux/iio/iio.h>
+#include <linux/iio/buffer.h>
+#include <linux/iio/trigger.h>
+#include <linux/iio/trigger_consumer.h>
+#include <linux/iio/triggered_buffer.h>
+
+#include "defs.h"
+#include "hcsr_drv.h"
+#include "hcsr_iio.h"
+
+/** iio private data */
+struct hcsr_iio {
+        hcsr_dev_t *devp;                       /**< The hcsr04 device */
+        struct iio_trigger *trig;               /**< Fired per sampling round */
+};
+
+static const struct iio_chan_spec hcsr_iio_channels[] = {
+        {
+                .type = IIO_DISTANCE,
+                .info_mask_separate = BIT(IIO_CHAN_INFO_RAW),
+                .info_mask_shared_by_type = BIT(IIO_CHAN_INFO_SCALE),
+                .scan_index = 0,
+                .scan_type = {
+                        .sign = 'u',
+                        .realbits = 32,
+                        .storagebits = 32,
+                        .endianness = IIO_CPU,
+                },
+        },
+        IIO_CHAN_SOFT_TIMESTAMP(1),
+};
+
+/**
+ * @brief take one measurement, sharing the round in flight if any.
+ * @param devp, a valid device pointer.
+ * @param res, storage for the result.
+ * @return 0 on success, otherwise errno.
+ */
+static int hcsr_iio_measure(hcsr_dev_t *devp, result_info_t *res) {
+        unsigned int req;
+
+        if (devp->settings.pins.trigger_pin == -1 || devp->settings.pins.echo_pin == -1)
+                return -EINVAL;
+
+        req = hcsr_request_join(devp);
+        if (wait_event_interruptible(devp->result_wq, hcsr_request_done(devp, req)))
+                return -ERESTARTSYS;
+
+        hcsr_get_latest(devp, res);
+        return 0;
+}
+
+static int hcsr_iio_read_raw(struct iio_dev *indio_dev,
+                             struct iio_chan_spec const *chan,
+                             int *val, int *val2, long mask) {
+        struct hcsr_iio *priv = iio_priv(indio_dev);
+        result_info_t res;
+        int ret;
+
+        switch (mask) {
+                case IIO_CHAN_INFO_RAW:
+                        // The buffer owns the sampling while enabled.
+                        if (iio_buffer_enabled(indio_dev))
+                                return -EBUSY;
+                        ret = hcsr_iio_measure(priv->devp, &res);
+                        if (ret)
+                                return ret;
+                        *val = res.measurement;
+                        return IIO_VAL_INT;
+                case IIO_CHAN_INFO_SCALE:
+                        // mm to m.
+                        *val = 0;
+                        *val2 = 1000;
+                        return IIO_VAL_INT_PLUS_MICRO;
+                default:
+                        return -EINVAL;
+        }
+}
+
+static const struct iio_info hcsr_iio_info = {
+        .driver_module = THIS_MODULE,
+        .read_raw = hcsr_iio_read_raw,
+};
+
+static const struct iio_trigger_ops hcsr_iio_trigger_ops = {
+        .owner = THIS_MODULE,
+};
+
+/**
+ * @brief push the latest result into the buffer.
+ * @param irq, unused.
+ * @param p, the poll function.
+ * @return IRQ_HANDLED.
+ * @note runs nested in the sampling thread, right after the result.
+ */
+static irqreturn_t hcsr_iio_trigger_handler(int irq, void *p) {
+        struct iio_poll_func *pf = p;
+        struct iio_dev *indio_dev = pf->indio_dev;
+        struct hcsr_iio *priv = iio_priv(indio_dev);
+        result_info_t res;
+        // distance and the 8 byte aligned timestamp.
+        struct {
+                u32 distance;
+                s64 ts __aligned(8);
+        } scan;
+
+        // Padding included, no stack leaks into the buffer.
+        memset(&scan, 0, sizeof(scan));
+        hcsr_get_latest(priv->devp, &res);
+        scan.distance = res.measurement;
+        // Fired nested from the sampling thread, the top half did not run.
+        iio_push_to_buffers_with_timestamp(indio_dev, &scan, iio_get_time_ns());
+
+        iio_trigger_notify_done(indio_dev->trig);
+        return IRQ_HANDLED;
+}
+
+int hcsr_iio_add(hcsr_dev_t *devp, struct device *parent) {
+        struct iio_dev *indio_dev;
+        struct hcsr_iio *priv;
+        int ret;
+
+        indio_dev = iio_device_alloc(sizeof(struct hcsr_iio));
+        if (indio_dev == NULL)
+                return -ENOMEM;
+
+        priv = iio_priv(indio_dev);
+        priv->devp = devp;
+
+        indio_dev->dev.parent = parent;
+        indio_dev->name = devp->name;
+        indio_dev->info = &hcsr_iio_info;
+        indio_dev->modes = INDIO_DIRECT_MODE;
+        indio_dev->channels = hcsr_iio_channels;
+        indio_dev->num_channels = ARRAY_SIZE(hcsr_iio_channels);
+
+        // Trigger fired by the sampling thread, the default for this device.
+        priv->trig = iio_trigger_alloc("%s-dev%d", indio_dev->name, indio_dev->id);
+        if (priv->trig == NULL) {
+                ret = -ENOMEM;
+                goto free_dev;
+        }
+        priv->trig->dev.parent = parent;
+        priv->trig->ops = &hcsr_iio_trigger_ops;
+        iio_trigger_set_drvdata(priv->trig, indio_dev);
+        ret = iio_trigger_register(priv->trig);
+        if (ret)
+                goto free_trig;
+        indio_dev->trig = iio_trigger_get(priv->trig);
+
+        // kfifo buffer filled from the trigger.
+        ret = iio_triggered_buffer_setup(indio_dev, iio_pollfunc_store_time,
+                                         hcsr_iio_trigger_handler, NULL);
+        if (ret)
+                goto unregister_trig;
+
+        ret = iio_device_register(indio_dev);
+        if (ret)
+                goto cleanup_buffer;
+
+        devp->indio_dev = indio_dev;
+        return 0;
+
+cleanup_buffer:
+        iio_triggered_buffer_cleanup(indio_dev);
+unregister_trig:
+        iio_trigger_put(indio_dev->trig);
+        indio_dev->trig = NULL;
+        iio_trigger_unregister(priv->trig);
+free_trig:
+        iio_trigger_free(priv->trig);
+free_dev:
+        iio_device_free(indio_dev);
+        return ret;
+}
+
+void hcsr_iio_remove(hcsr_dev_t *devp) {
+        struct iio_dev *indio_dev = devp->indio_dev;
+        struct iio_trigger *trig;
+
+        if (indio_dev == NULL)
+                return;
+
+        trig = ((struct hcsr_iio *)iio_priv(indio_dev))->trig;
+        devp->indio_dev = NULL;
+
+        iio_device_unregister(indio_dev);
+        iio_triggered_buffer_cleanup(indio_dev);
+        iio_trigger_unregister(trig);
+        // Drops the reference the device holds on its trigger.
+        iio_device_free(indio_dev);
+        iio_trigger_free(trig);
+}
+
+void hcsr_iio_poll(hcsr_dev_t *devp) {
+        struct iio_dev *indio_dev = ACCESS_ONCE(devp->indio_dev);
+
+        if (indio_dev == NULL || !iio_buffer_enabled(indio_dev))
+                return;
+
+        iio_trigger_poll_chained(((struct hcsr_iio *)iio_priv(indio_dev))->trig);
+}
@@ -0,0 +1,42 @@
+/**
+ * @file hcsr_iio.h
+ * @brief Industrial I/O front-end of hcsr04 devices.
+ * 
+ * @author Xiangyu Guo
+ */
+#ifndef __HCSR_IIO_H__
+#define __HCSR_IIO_H__
+
+#include <linux/kconfig.h>
+#include <linux/device.h>
+
+#include "hcsr04.h"
+
+#if IS_ENABLED(CONFIG_IIO_TRIGGERED_BUFFER)
+/**
+ * @brief register the iio device, trigger and buffer of a device.
+ * @param devp, a valid device pointer.
+ * @param parent, the device to show the iio device under.
+ * @return 0 on success, otherwise errno.
+ */
+int hcsr_iio_add(hcsr_dev_t *, struct device *);
+
+/**
+ * @brief unregister the iio device of a device.
+ * @param devp, a valid device pointer.
+ */
+void hcsr_iio_remove(hcsr_dev_t *);
+
+/**
+ * @brief fire the trigger, the result just queued goes into the buffer.
+ * @param devp, a valid device pointer.
+ * @note sampling thread context.
+ */
+void hcsr_iio_poll(hcsr_dev_t *);
+#else
+static inline int hcsr_iio_add(hcsr_dev_t *devp, struct device *parent) { return 0; }
+static inline void hcsr_iio_remove(hcsr_dev_t *devp) {}
+static inline void hcsr_iio_poll(hcsr_dev_t *devp) {}
+#endif
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * @file hcsr_mmap.c
+ * @brief Shared result ring of hcsr04 device, mapped to user space.
+ * 
+ * @author Xiangyu Guo
+ */
+#include <linux/kernel.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+
+#include <asm/barrier.h>
+
+#include "hcsr_mmap.h"
+
+#define HCSR_MMAP_SIZE  PAGE_ALIGN(HCSR_MMAP_HDR + \
+                                   HCSR_MMAP_SLOTS * sizeof(result_info_t))
+
+/**
+ * @brief address of the slot holding the result with the given index.
+ * @param hdr, a valid shared ring header.
+ * @param idx, free running result index.
+ * @return pointer to the slot.
+ */
+static inline result_info_t *hcsr_mmap_slot(hcsr_mmap_header_t *hdr, unsigned int idx) {
+        result_info_t *slots = (result_info_t *)((char *)hdr + hdr->offset);
+
+        return &slots[idx & (hdr->slots - 1)];
+}
+
+int hcsr_mmap_init(hcsr_dev_t *devp) {
+        BUILD_BUG_ON(HCSR_MMAP_SLOTS & (HCSR_MMAP_SLOTS - 1));
+        BUILD_BUG_ON(HCSR_MMAP_HDR % PAGE_SIZE);
+
+        // Zeroed, and safe to hand out to user space page by page.
+        devp->shared = vmalloc_user(HCSR_MMAP_SIZE);
+        if (devp->shared == NULL)
+                return -ENOMEM;
+
+        devp->shared->slots = HCSR_MMAP_SLOTS;
+        devp->shared->offset = HCSR_MMAP_HDR;
+        return 0;
+}
+
+void hcsr_mmap_fini(hcsr_dev_t *devp) {
+        // Pages stay alive until the last user unmaps them.
+        vfree(devp->shared);
+        devp->shared = NULL;
+}
+
+void hcsr_mmap_put(hcsr_dev_t *devp, const result_info_t *res) {
+        hcsr_mmap_header_t *hdr = devp->shared;
+        unsigned int head = hdr->head;
+
+        // Odd sequence tells the readers a slot is changing.
+        hdr->seq++;
+        smp_wmb();
+
+        *hcsr_mmap_slot(hdr, head) = *res;
+
+        smp_wmb();
+        hdr->head = head + 1;
+        hdr->seq++;
+}
+
+unsigned int hcsr_mmap_head(hcsr_dev_t *devp) {
+        return smp_load_acquire(&devp->shared->head);
+}
+
+int hcsr_mmap_map(hcsr_dev_t *devp, struct vm_area_struct *vma) {
+        // The ring belongs to the sampling thread, readers only look.
+        if (vma->vm_flags & VM_WRITE)
+                return -EPERM;
+
+        if (vma->vm_pgoff != 0 || vma->vm_end - vma->vm_start > HCSR_MMAP_SIZE)
+                return -EINVAL;
+
+        vma->vm_flags &= ~VM_MAYWRITE;
+        return remap_vmalloc_range(vma, devp->shared, 0);
+}
@@ -0,0 +1,50 @@
+/**
+ * @file hcsr_mmap.h
+ * @brief Shared result ring of hcsr04 device, mapped to user space.
+ * 
+ * @author Xiangyu Guo
+ */
+#ifndef __HCSR_MMAP_H__
+#define __HCSR_MMAP_H__
+
+#include <linux/mm.h>
+
+#include "defs.h"
+
+/**
+ * @brief allocate the shared result ring.
+ * @param devp, a valid device pointer.
+ * @return 0, on success; otherwise errno.
+ */
+int hcsr_mmap_init(hcsr_dev_t *);
+
+/**
+ * @brief release the shared result ring.
+ * @param devp, a valid device pointer.
+ */
+void hcsr_mmap_fini(hcsr_dev_t *);
+
+/**
+ * @brief publish one result to the shared result ring.
+ * @param devp, a valid device pointer.
+ * @param res, the result to publish.
+ * @note single producer, called from the sampling thread only.
+ */
+void hcsr_mmap_put(hcsr_dev_t *, const result_info_t *);
+
+/**
+ * @brief current producer index of the shared result ring.
+ * @param devp, a valid device pointer.
+ * @return the number of results published so far.
+ */
+unsigned int hcsr_mmap_head(hcsr_dev_t *);
+
+/**
+ * @brief map the shared result ring, read only.
+ * @param devp, a valid device pointer.
+ * @param vma, the user space area.
+ * @return 0, on success; otherwise errno.
+ */
+int hcsr_mmap_map(hcsr_dev_t *, struct vm_area_struct *);
+
+#endif
@@ -0,0 +1,154 @@
+/**
+ * @file hcsr_sim.c
+ * @brief simulated pins and synthetic echo for hcsr04 device without a board.
+ *
+ * Load with sim_chip=<label> to map shield pin N to line N of a gpio-mockup
+ * (or gpio-sim) chip. Each trigger is answered by a rising and a falling
+ * edge raised on the echo line's irq from an hrtimer, so the real isr and
+ * sampling path run unchanged.
+ * @author Xiangyu Guo
+ */
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/gpio.h>
+#include <linux/gpio/driver.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/hrtimer.h>
+#include <linux/random.h>
+#include <linux/string.h>
+
+#include "hcsr_sim.h"
+
+#define SIM_PINS        (20)                    /**< Shield pins mapped to the chip */
+#define SIM_NS_PER_MM   (5831)                  /**< Round trip of 1 mm at 343 m/s */
+#define SIM_BURST_NS    (250000)                /**< Trigger to echo rising edge */
+#define SIM_MIN_MM      (20)                    /**< Closest distance the sensor sees */
+
+/** Label of the simulator chip, NULL for the Galileo shield */
+static char *sim_chip = NULL;
+module_param(sim_chip, charp, S_IRUGO);
+MODULE_PARM_DESC(sim_chip, "gpio-mockup/gpio-sim chip label to use instead of the shield");
+
+/** Simulated distance in mm */
+static int sim_distance = 1000;
+module_param(sim_distance, int, S_IRUGO | S_IWUSR);
+
+/** Uniform noise on the distance, +/- mm */
+static int sim_noise = 0;
+module_param(sim_noise, int, S_IRUGO | S_IWUSR);
+
+/** Percentage of triggers without an echo */
+static int sim_dropout = 0;
+module_param(sim_dropout, int, S_IRUGO | S_IWUSR);
+
+typedef struct hcsr_echo {
+        struct hrtimer timer;                   /**< Fires on each echo edge */
+        unsigned int irq;                       /**< Irq of the echo line */
+        int level;                              /**< Echo level after the next edge */
+        u64 width;                              /**< Echo pulse width in ns */
+} hcsr_echo_t;
+
+static struct gpio_chip *s_chip = NULL;         /**< Simulator chip */
+static hcsr_echo_t s_echo[SIM_PINS];            /**< Echo generator per pin */
+
+/**
+ * @brief match a gpio chip by label.
+ * @param chip, the candidate chip.
+ * @param data, the label.
+ * @return 1 on match, otherwise 0.
+ */
+static int hcsr_sim_match(struct gpio_chip *chip, void *data) {
+        return chip->label && !strcmp(chip->label, data);
+}
+
+/**
+ * @brief raise the next echo edge.
+ * @param timer, the echo timer.
+ * @return HRTIMER_RESTART until the falling edge is sent.
+ */
+static enum hrtimer_restart hcsr_sim_edge(struct hrtimer *timer) {
+        hcsr_echo_t *echo = container_of(timer, hcsr_echo_t, timer);
+
+        generic_handle_irq(echo->irq);
+        if (echo->level++)
+                return HRTIMER_NORESTART;
+
+        hrtimer_forward_now(timer, ns_to_ktime(echo->width));
+        return HRTIMER_RESTART;
+}
+
+int hcsr_sim_init(void) {
+        int i;
+
+        if (sim_chip == NULL)
+                return 0;
+
+        s_chip = gpiochip_find(sim_chip, hcsr_sim_match);
+        if (s_chip == NULL) {
+                printk(KERN_ALERT "No gpio chip labeled %s\n", sim_chip);
+                return -ENODEV;
+        }
+        if (s_chip->ngpio < SIM_PINS) {
+                printk(KERN_ALERT "%s has %u lines, need %d\n", sim_chip,
+                        s_chip->ngpio, SIM_PINS);
+                s_chip = NULL;
+                return -ENODEV;
+        }
+
+        for (i = 0; i < SIM_PINS; ++i) {
+                hrtimer_init(&s_echo[i].timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+                s_echo[i].timer.function = hcsr_sim_edge;
+        }
+
+        printk(KERN_INFO "Simulated pins on %s, base %d\n", sim_chip, s_chip->base);
+        return 0;
+}
+
+void hcsr_sim_exit(void) {
+        int i;
+
+        if (s_chip == NULL)
+                return;
+
+        for (i = 0; i < SIM_PINS; ++i)
+                hrtimer_cancel(&s_echo[i].timer);
+        s_chip = NULL;
+}
+
+int hcsr_sim_enabled(void) {
+        return s_chip != NULL;
+}
+
+int hcsr_sim_shield_to_gpio(int pin) {
+        if (pin < 0 || pin >= SIM_PINS)
+                return -EINVAL;
+
+        return s_chip->base + pin;
+}
+
+void hcsr_sim_echo(int pin) {
+        hcsr_echo_t *echo;
+        int mm;
+
+        if (s_chip == NULL || pin < 0 || pin >= SIM_PINS)
+                return;
+
+        echo = &s_echo[pin];
+        // Still ringing from the previous trigger.
+        if (hrtimer_active(&echo->timer))
+                return;
+
+        if (sim_dropout > 0 && prandom_u32() % 100 < sim_dropout)
+                return;
+
+        mm = sim_distance;
+        if (sim_noise > 0)
+                mm += (int)(prandom_u32() % (2 * sim_noise + 1)) - sim_noise;
+        mm = max(mm, SIM_MIN_MM);
+
+        echo->irq = gpio_to_irq(s_chip->base + pin);
+        echo->width = (u64)mm * SIM_NS_PER_MM;
+        echo->level = 0;
+        hrtimer_start(&echo->timer, ns_to_ktime(SIM_BURST_NS), HRTIMER_MODE_REL);
+}
@@ -0,0 +1,39 @@
+/**
+ * @file hcsr_sim.h
+ * @brief simulated pins and synthetic echo for hcsr04 device without a board.
+ * @author Xiangyu Guo
+ */
+#ifndef __HCSR_SIM_H__
+#define __HCSR_SIM_H__
+
+/**
+ * @brief bind to the simulator gpio chip named by sim_chip, if any.
+ * @return 0 on success or when no simulator is asked for, otherwise errno.
+ */
+int hcsr_sim_init(void);
+
+/**
+ * @brief stop all pending echoes.
+ */
+void hcsr_sim_exit(void);
+
+/**
+ * @brief pins live on the simulator chip instead of the Galileo shield.
+ * @return 1 when simulated, otherwise 0.
+ */
+int hcsr_sim_enabled(void);
+
+/**
+ * @brief convert the shield pin number to a line on the simulator chip.
+ * @param pin, shield pin number.
+ * @return positive on valid linux pin #, otherwise errno.
+ */
+int hcsr_sim_shield_to_gpio(int);
+
+/**
+ * @brief answer a trigger with a synthetic echo pulse on the echo pin.
+ * @param pin, shield pin number of the echo pin.
+ */
+void hcsr_sim_echo(int);
+
+#endif
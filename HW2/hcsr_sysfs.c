@@ -11,6 +11,7 @@
 #include "defs.h"
 #include "hcsr_drv.h"
 #include "hcsr_config.h"
+#include "hcsr_conv.h"
 
 /** ==========================================================================
  *                      Distance sysfs attribute
@@ -44,23 +45,21 @@ ssize_t hcsr_trigger_store(struct device *dev,
                            size_t count) {
         int pin;
         int status;
+        pins_setting_t pins;
         hcsr_dev_t *devp = dev_get_drvdata(dev);
-        status = sscanf(buf, "%d", &pin);
+        if (sscanf(buf, "%d", &pin) != 1 || pin < 0)
+                return -EINVAL;
         // lock the device, make sure no measurement using the pin.
         if (hcsr_lock(devp))
                 return -EBUSY;
-        if (hcsr04_config_validate_pin(pin)) {
-                hcsr_unlock(devp);
-                return -EINVAL;
-        }
-        if (devp->settings.pins.trigger_pin != -1)
-                hcsr04_fini_pins(devp->settings.pins.trigger_pin);
 
-        devp->settings.pins.trigger_pin = -1;
-
-        if (hcsr04_init_pins(pin, OUTPUT)) {
+        // Only the lines that differ from the current setup are touched.
+        pins = devp->settings.pins;
+        pins.trigger_pin = pin;
+        status = hcsr04_config_update(&devp->settings.pins, &pins);
+        if (status) {
                 hcsr_unlock(devp);
-                return -EBUSY;
+                return status;
         }
 
         devp->settings.pins.trigger_pin = pin;
@@ -86,27 +85,27 @@ ssize_t hcsr_echo_store(struct device *dev,
                         size_t count) {
         int pin;
         int status;
+        pins_setting_t pins;
         hcsr_dev_t *devp = dev_get_drvdata(dev);
-        status = sscanf(buf, "%d", &pin);
+        if (sscanf(buf, "%d", &pin) != 1 || pin < 0)
+                return -EINVAL;
         // lock the device, make sure no measurement using the pin.
         if (hcsr_lock(devp))
                 return -EBUSY;
-        if (hcsr04_config_validate_pin(pin) ||
-            hcsr04_config_validate_echo(pin)) {
-                hcsr_unlock(devp);
-                return -EINVAL;
-        }
-        if (devp->settings.pins.echo_pin != -1)
-                hcsr04_fini_pins(devp->settings.pins.echo_pin);
 
         // Remove isr and irq_no
         hcsr_isr_exit(devp);
 
-        devp->settings.pins.echo_pin = -1;
-
-        if (hcsr04_init_pins(pin, INPUT)) {
+        // Only the lines that differ from the current setup are touched.
+        pins = devp->settings.pins;
+        pins.echo_pin = pin;
+        status = hcsr04_config_update(&devp->settings.pins, &pins);
+        if (status) {
+                // The old pin stays, so does its isr.
+                if (devp->irq_no && hcsr_isr_init(devp) < 0)
+                        devp->irq_no = 0;
                 hcsr_unlock(devp);
-                return -EBUSY;
+                return status;
         }
 
         devp->settings.pins.echo_pin = pin;
@@ -152,11 +151,6 @@ ssize_t hcsr_samples_store(struct device *dev,
         if (hcsr_lock(devp))
                 return -EBUSY;
         // update m
-        if (hcsr_reallocate(devp, m + NUM_OF_OUTLIER)) {
-                hcsr_unlock(devp);
-                return -ENOMEM;
-        }
-
         devp->settings.params.m = m + NUM_OF_OUTLIER;
 
         // unlock the device
@@ -225,4 +219,306 @@ ssize_t hcsr_enable_store(struct device *dev,
                 devp->settings.endless = val;
         }
         return count;
-}
\ No newline at end of file
+}
+/** ==========================================================================
+ *                      Filter sysfs attributes
+ *============================================================================*/
+static void hcsr_filter_set_type(filter_setting_t *filter, unsigned int val) {
+        filter->type = val;
+}
+
+static void hcsr_filter_set_trim(filter_setting_t *filter, unsigned int val) {
+        filter->trim = val;
+}
+
+static void hcsr_filter_set_alpha(filter_setting_t *filter, unsigned int val) {
+        filter->alpha = val;
+}
+
+static void hcsr_filter_set_beta(filter_setting_t *filter, unsigned int val) {
+        filter->beta = val;
+}
+
+/**
+ * @brief update one field of the filter setting.
+ * @param devp, a valid device pointer.
+ * @param set, setter of the field.
+ * @param val, the new value.
+ * @return 0 on success, otherwise errno.
+ */
+static int hcsr_filter_update(hcsr_dev_t *devp,
+                              void (*set)(filter_setting_t *, unsigned int),
+                              unsigned int val) {
+        filter_setting_t filter;
+
+        // lock the device
+        if (hcsr_lock(devp))
+                return -EBUSY;
+
+        filter = devp->filter.setting;
+        set(&filter, val);
+        if (hcsr_filter_validate(&filter)) {
+                hcsr_unlock(devp);
+                return -EINVAL;
+        }
+        // Start over, tracker state belongs to the old filter.
+        hcsr_filter_init(&devp->filter, &filter);
+
+        // unlock the device
+        hcsr_unlock(devp);
+        return 0;
+}
+
+ssize_t hcsr_filter_show(struct device *dev,
+                         struct device_attribute *attr,
+                         char *buf) {
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        return sprintf(buf, "%u\n", devp->filter.setting.type);
+}
+
+ssize_t hcsr_filter_store(struct device *dev,
+                          struct device_attribute *attr,
+                          const char *buf,
+                          size_t count) {
+        unsigned int val;
+        int status;
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        if (sscanf(buf, "%u", &val) != 1)
+                return -EINVAL;
+
+        status = hcsr_filter_update(devp, hcsr_filter_set_type, val);
+        return status ? status : count;
+}
+
+ssize_t hcsr_filter_trim_show(struct device *dev,
+                              struct device_attribute *attr,
+                              char *buf) {
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        return sprintf(buf, "%u\n", devp->filter.setting.trim);
+}
+
+ssize_t hcsr_filter_trim_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf,
+                               size_t count) {
+        unsigned int val;
+        int status;
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        if (sscanf(buf, "%u", &val) != 1)
+                return -EINVAL;
+
+        status = hcsr_filter_update(devp, hcsr_filter_set_trim, val);
+        return status ? status : count;
+}
+
+ssize_t hcsr_filter_alpha_show(struct device *dev,
+                               struct device_attribute *attr,
+                               char *buf) {
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        return sprintf(buf, "%u\n", devp->filter.setting.alpha);
+}
+
+ssize_t hcsr_filter_alpha_store(struct device *dev,
+                                struct device_attribute *attr,
+                                const char *buf,
+                                size_t count) {
+        unsigned int val;
+        int status;
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        if (sscanf(buf, "%u", &val) != 1)
+                return -EINVAL;
+
+        status = hcsr_filter_update(devp, hcsr_filter_set_alpha, val);
+        return status ? status : count;
+}
+
+ssize_t hcsr_filter_beta_show(struct device *dev,
+                              struct device_attribute *attr,
+                              char *buf) {
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        return sprintf(buf, "%u\n", devp->filter.setting.beta);
+}
+
+ssize_t hcsr_filter_beta_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf,
+                               size_t count) {
+        unsigned int val;
+        int status;
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        if (sscanf(buf, "%u", &val) != 1)
+                return -EINVAL;
+
+        status = hcsr_filter_update(devp, hcsr_filter_set_beta, val);
+        return status ? status : count;
+}
+
+/** ==========================================================================
+ *                      Adaptive sampling sysfs attributes
+ *============================================================================*/
+ssize_t hcsr_adaptive_show(struct device *dev,
+                           struct device_attribute *attr,
+                           char *buf) {
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        return sprintf(buf, "%d\n", devp->settings.adaptive);
+}
+
+ssize_t hcsr_adaptive_store(struct device *dev,
+                            struct device_attribute *attr,
+                            const char *buf,
+                            size_t count) {
+        int val;
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        if (sscanf(buf, "%d", &val) != 1)
+                return -EINVAL;
+        // lock the device
+        if (hcsr_lock(devp))
+                return -EBUSY;
+
+        devp->settings.adaptive = !!val;
+
+        // unlock the device
+        hcsr_unlock(devp);
+        return count;
+}
+
+ssize_t hcsr_max_range_show(struct device *dev,
+                            struct device_attribute *attr,
+                            char *buf) {
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        return sprintf(buf, "%u\n", devp->settings.max_range);
+}
+
+ssize_t hcsr_max_range_store(struct device *dev,
+                             struct device_attribute *attr,
+                             const char *buf,
+                             size_t count) {
+        unsigned int val;
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        if (sscanf(buf, "%u", &val) != 1 || val == 0 || val > MAX_RANGE)
+                return -EINVAL;
+        // lock the device
+        if (hcsr_lock(devp))
+                return -EBUSY;
+
+        devp->settings.max_range = val;
+
+        // unlock the device
+        hcsr_unlock(devp);
+        return count;
+}
+
+ssize_t hcsr_guard_show(struct device *dev,
+                        struct device_attribute *attr,
+                        char *buf) {
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        return sprintf(buf, "%u\n", devp->settings.guard);
+}
+
+ssize_t hcsr_guard_store(struct device *dev,
+                         struct device_attribute *attr,
+                         const char *buf,
+                         size_t count) {
+        unsigned int val;
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        if (sscanf(buf, "%u", &val) != 1 || val > MAX_GUARD)
+                return -EINVAL;
+        // lock the device
+        if (hcsr_lock(devp))
+                return -EBUSY;
+
+        devp->settings.guard = val;
+
+        // unlock the device
+        hcsr_unlock(devp);
+        return count;
+}
+
+ssize_t hcsr_rate_show(struct device *dev,
+                       struct device_attribute *attr,
+                       char *buf) {
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+        unsigned int rate = devp->settings.rate;
+
+        // Triggers per second of the last round.
+        return sprintf(buf, "%u.%03u\n", rate / 1000, rate % 1000);
+}
+
+/** ==========================================================================
+ *                      Early termination sysfs attribute
+ *============================================================================*/
+ssize_t hcsr_tolerance_show(struct device *dev,
+                            struct device_attribute *attr,
+                            char *buf) {
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        return sprintf(buf, "%u\n", devp->settings.tolerance);
+}
+
+ssize_t hcsr_tolerance_store(struct device *dev,
+                             struct device_attribute *attr,
+                             const char *buf,
+                             size_t count) {
+        unsigned int val;
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        if (sscanf(buf, "%u", &val) != 1 || val > MAX_RANGE * 10)
+                return -EINVAL;
+        // lock the device
+        if (hcsr_lock(devp))
+                return -EBUSY;
+
+        // mm, 0 always takes m triggers.
+        devp->settings.tolerance = val;
+
+        // unlock the device
+        hcsr_unlock(devp);
+        return count;
+}
+
+/** ==========================================================================
+ *                      Temperature sysfs attribute
+ *============================================================================*/
+ssize_t hcsr_temperature_show(struct device *dev,
+                              struct device_attribute *attr,
+                              char *buf) {
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        return sprintf(buf, "%d\n", devp->settings.temperature);
+}
+
+ssize_t hcsr_temperature_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf,
+                               size_t count) {
+        int val;
+        hcsr_dev_t *devp = dev_get_drvdata(dev);
+
+        if (sscanf(buf, "%d", &val) != 1 || val < MIN_TEMP || val > MAX_TEMP)
+                return -EINVAL;
+        // lock the device
+        if (hcsr_lock(devp))
+                return -EBUSY;
+
+        // Speed of sound follows the air temperature.
+        devp->settings.temperature = val;
+        devp->settings.mm_mult = hcsr_conv_mult(val);
+
+        // unlock the device
+        hcsr_unlock(devp);
+        return count;
+}
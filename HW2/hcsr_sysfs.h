@@ -66,6 +66,102 @@ ssize_t hcsr_enable_store(struct device *dev,
 
 static DEVICE_ATTR(enable, S_IRUSR | S_IWUSR, hcsr_enable_show, hcsr_enable_store);
 
+ssize_t hcsr_filter_show(struct device *dev,
+                         struct device_attribute *attr,
+                         char *buf);
+ssize_t hcsr_filter_store(struct device *dev,
+                          struct device_attribute *attr,
+                          const char *buf,
+                          size_t count);
+
+static DEVICE_ATTR(filter, S_IRUSR | S_IWUSR, hcsr_filter_show, hcsr_filter_store);
+
+ssize_t hcsr_filter_trim_show(struct device *dev,
+                              struct device_attribute *attr,
+                              char *buf);
+ssize_t hcsr_filter_trim_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf,
+                               size_t count);
+
+static DEVICE_ATTR(filter_trim, S_IRUSR | S_IWUSR, hcsr_filter_trim_show, hcsr_filter_trim_store);
+
+ssize_t hcsr_filter_alpha_show(struct device *dev,
+                               struct device_attribute *attr,
+                               char *buf);
+ssize_t hcsr_filter_alpha_store(struct device *dev,
+                                struct device_attribute *attr,
+                                const char *buf,
+                                size_t count);
+
+static DEVICE_ATTR(filter_alpha, S_IRUSR | S_IWUSR, hcsr_filter_alpha_show, hcsr_filter_alpha_store);
+
+ssize_t hcsr_filter_beta_show(struct device *dev,
+                              struct device_attribute *attr,
+                              char *buf);
+ssize_t hcsr_filter_beta_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf,
+                               size_t count);
+
+static DEVICE_ATTR(filter_beta, S_IRUSR | S_IWUSR, hcsr_filter_beta_show, hcsr_filter_beta_store);
+
+ssize_t hcsr_adaptive_show(struct device *dev,
+                           struct device_attribute *attr,
+                           char *buf);
+ssize_t hcsr_adaptive_store(struct device *dev,
+                            struct device_attribute *attr,
+                            const char *buf,
+                            size_t count);
+
+static DEVICE_ATTR(adaptive, S_IRUSR | S_IWUSR, hcsr_adaptive_show, hcsr_adaptive_store);
+
+ssize_t hcsr_max_range_show(struct device *dev,
+                            struct device_attribute *attr,
+                            char *buf);
+ssize_t hcsr_max_range_store(struct device *dev,
+                             struct device_attribute *attr,
+                             const char *buf,
+                             size_t count);
+
+static DEVICE_ATTR(max_range, S_IRUSR | S_IWUSR, hcsr_max_range_show, hcsr_max_range_store);
+
+ssize_t hcsr_guard_show(struct device *dev,
+                        struct device_attribute *attr,
+                        char *buf);
+ssize_t hcsr_guard_store(struct device *dev,
+                         struct device_attribute *attr,
+                         const char *buf,
+                         size_t count);
+
+static DEVICE_ATTR(guard_time, S_IRUSR | S_IWUSR, hcsr_guard_show, hcsr_guard_store);
+
+ssize_t hcsr_rate_show(struct device *dev,
+                       struct device_attribute *attr,
+                       char *buf);
+
+static DEVICE_ATTR(sampling_rate, S_IRUSR, hcsr_rate_show, NULL);
+
+ssize_t hcsr_tolerance_show(struct device *dev,
+                            struct device_attribute *attr,
+                            char *buf);
+ssize_t hcsr_tolerance_store(struct device *dev,
+                             struct device_attribute *attr,
+                             const char *buf,
+                             size_t count);
+
+static DEVICE_ATTR(tolerance, S_IRUSR | S_IWUSR, hcsr_tolerance_show, hcsr_tolerance_store);
+
+ssize_t hcsr_temperature_show(struct device *dev,
+                              struct device_attribute *attr,
+                              char *buf);
+ssize_t hcsr_temperature_store(struct device *dev,
+                               struct device_attribute *attr,
+                               const char *buf,
+                               size_t count);
+
+static DEVICE_ATTR(temperature, S_IRUSR | S_IWUSR, hcsr_temperature_show, hcsr_temperature_store);
+
 static struct attribute *hcsr_attrs[] = {
         &dev_attr_distance.attr,
         &dev_attr_trigger.attr,
@@ -73,6 +169,16 @@ static struct attribute *hcsr_attrs[] = {
         &dev_attr_number_samples.attr,
         &dev_attr_sampling_period.attr,
         &dev_attr_enable.attr,
+        &dev_attr_filter.attr,
+        &dev_attr_filter_trim.attr,
+        &dev_attr_filter_alpha.attr,
+        &dev_attr_filter_beta.attr,
+        &dev_attr_adaptive.attr,
+        &dev_attr_max_range.attr,
+        &dev_attr_guard_time.attr,
+        &dev_attr_sampling_rate.attr,
+        &dev_attr_tolerance.attr,
+        &dev_attr_temperature.attr,
         NULL,
 };
 
@@ -0,0 +1,177 @@
+/**
+ * @file hcsr_thresh.c
+ * @brief Proximity threshold events with hysteresis and debounce.
+ *
+ * Every result falls in one zone: near, middle or far. A zone is left only
+ * once a result is hysteresis past its limit, and the new zone is taken
+ * only after debounce results in a row agree on it. Taking a zone queues
+ * one event and wakes its waiters; results staying in a zone wake nobody.
+ * 
+ * @author Xiangyu Guo
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/errno.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
+
+#include "defs.h"
+#include "hcsr_thresh.h"
+
+#include "common.h"
+
+/**
+ * @brief the zone of one distance.
+ * @param setting, the threshold setting.
+ * @param zone, the current zone, its limit is widened by the hysteresis.
+ * @param mm, the distance in mm.
+ * @return enum hcsr_zone.
+ */
+static unsigned int hcsr_thresh_zone(const threshold_setting_t *setting,
+                                     unsigned int zone, unsigned long long mm) {
+        unsigned int limit;
+
+        if (setting->near) {
+                limit = setting->near;
+                if (zone == HCSR_ZONE_NEAR)
+                        limit += setting->hysteresis;
+                if (mm < limit)
+                        return HCSR_ZONE_NEAR;
+        }
+
+        if (setting->far) {
+                limit = setting->far;
+                if (zone == HCSR_ZONE_FAR)
+                        limit -= setting->hysteresis;
+                if (mm > limit)
+                        return HCSR_ZONE_FAR;
+        }
+
+        return HCSR_ZONE_MIDDLE;
+}
+
+int hcsr_thresh_init(hcsr_dev_t *devp) {
+        struct hcsr_thresh *thresh = &devp->thresh;
+
+        spin_lock_init(&thresh->lock);
+        mutex_init(&thresh->events_lock);
+        init_waitqueue_head(&thresh->wq);
+        memset(&thresh->setting, 0, sizeof(threshold_setting_t));
+        thresh->zone = HCSR_ZONE_MIDDLE;
+        thresh->pending = HCSR_ZONE_MIDDLE;
+        thresh->count = 0;
+
+        thresh->events = rec_ring_buff_init(EVENT_QUEUE, sizeof(threshold_event_t));
+        if (thresh->events == NULL)
+                return -ENOMEM;
+
+        return 0;
+}
+
+void hcsr_thresh_fini(hcsr_dev_t *devp) {
+        rec_ring_buff_fini(devp->thresh.events);
+        devp->thresh.events = NULL;
+}
+
+int hcsr_thresh_validate(const threshold_setting_t *setting) {
+        if (setting->near > MAX_RANGE * 10 || setting->far > MAX_RANGE * 10)
+                return -EINVAL;
+        if (setting->debounce > MAX_DEBOUNCE)
+                return -EINVAL;
+        // Leaving far must not reach below zero.
+        if (setting->far && setting->hysteresis >= setting->far)
+                return -EINVAL;
+        // The widened zones must not overlap.
+        if (setting->near && setting->far &&
+            setting->near + 2 * setting->hysteresis >= setting->far)
+                return -EINVAL;
+        return 0;
+}
+
+void hcsr_thresh_set(hcsr_dev_t *devp, const threshold_setting_t *setting) {
+        struct hcsr_thresh *thresh = &devp->thresh;
+
+        mutex_lock(&thresh->events_lock);
+        spin_lock(&thresh->lock);
+        thresh->setting = *setting;
+        if (thresh->setting.debounce == 0)
+                thresh->setting.debounce = 1;
+        // The first result decides the zone again.
+        thresh->zone = HCSR_ZONE_MIDDLE;
+        thresh->pending = HCSR_ZONE_MIDDLE;
+        thresh->count = 0;
+        // Crossings of the old limits mean nothing now.
+        rec_ring_buff_removeall(thresh->events);
+        spin_unlock(&thresh->lock);
+        mutex_unlock(&thresh->events_lock);
+}
+
+void hcsr_thresh_update(hcsr_dev_t *devp, const result_info_t *res) {
+        struct hcsr_thresh *thresh = &devp->thresh;
+        threshold_event_t event;
+        unsigned int zone;
+
+        spin_lock(&thresh->lock);
+        if (!thresh->setting.near && !thresh->setting.far) {
+                spin_unlock(&thresh->lock);
+                return;
+        }
+
+        zone = hcsr_thresh_zone(&thresh->setting, thresh->zone, res->measurement);
+        if (zone == thresh->zone) {
+                // Bounced back, start over.
+                thresh->count = 0;
+                spin_unlock(&thresh->lock);
+                return;
+        }
+
+        if (zone != thresh->pending) {
+                thresh->pending = zone;
+                thresh->count = 0;
+        }
+
+        if (++thresh->count < thresh->setting.debounce) {
+                spin_unlock(&thresh->lock);
+                return;
+        }
+
+        event.zone = zone;
+        event.from = thresh->zone;
+        event.result = *res;
+        thresh->zone = zone;
+        thresh->count = 0;
+        rec_ring_buff_put(thresh->events, &event);
+        spin_unlock(&thresh->lock);
+
+        wake_up_interruptible(&thresh->wq);
+}
+
+int hcsr_thresh_get(hcsr_dev_t *devp, threshold_event_t *event, int nonblock) {
+        struct hcsr_thresh *thresh = &devp->thresh;
+        int ret;
+
+        do {
+                if (!hcsr_thresh_pending(devp)) {
+                        if (nonblock)
+                                return -EAGAIN;
+                        // Only a crossing wakes us, not every result.
+                        if (wait_event_interruptible(thresh->wq,
+                                        hcsr_thresh_pending(devp)))
+                                return -ERESTARTSYS;
+                }
+
+                // Another reader may have taken it in the meantime.
+                if (mutex_lock_interruptible(&thresh->events_lock))
+                        return -ERESTARTSYS;
+                ret = rec_ring_buff_get(thresh->events, event);
+                mutex_unlock(&thresh->events_lock);
+        } while (ret);
+
+        return 0;
+}
+
+int hcsr_thresh_pending(hcsr_dev_t *devp) {
+        return rec_ring_buff_count(devp->thresh.events) != 0;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file hcsr_thresh.h
+ * @brief Proximity threshold events with hysteresis and debounce.
+ * 
+ * @author Xiangyu Guo
+ */
+#ifndef __HCSR_THRESH_H__
+#define __HCSR_THRESH_H__
+
+#include "hcsr04.h"
+#include "common.h"
+
+#define EVENT_QUEUE     (16)                    /**< Crossings kept for the readers */
+#define MAX_DEBOUNCE    (64)                    /**< Most results to change zone */
+
+/**
+ * @brief initialize the threshold events of a device, no limit set.
+ * @param devp, a valid device pointer.
+ * @return 0 on success, otherwise errno.
+ */
+int hcsr_thresh_init(hcsr_dev_t *);
+
+/**
+ * @brief release the threshold events of a device.
+ * @param devp, a valid device pointer.
+ */
+void hcsr_thresh_fini(hcsr_dev_t *);
+
+/**
+ * @brief check a threshold setting.
+ * @param setting, the threshold setting.
+ * @return 0 when valid, otherwise -EINVAL.
+ */
+int hcsr_thresh_validate(const threshold_setting_t *);
+
+/**
+ * @brief replace the threshold setting, the zone starts over.
+ * @param devp, a valid device pointer.
+ * @param setting, a valid threshold setting.
+ * @note allowed while sampling, pending events are dropped.
+ */
+void hcsr_thresh_set(hcsr_dev_t *, const threshold_setting_t *);
+
+/**
+ * @brief evaluate one result, queue an event and wake the waiters on a crossing.
+ * @param devp, a valid device pointer.
+ * @param res, the result just published.
+ * @note sampling thread only.
+ */
+void hcsr_thresh_update(hcsr_dev_t *, const result_info_t *);
+
+/**
+ * @brief take the oldest crossing.
+ * @param devp, a valid device pointer.
+ * @param event, storage for the event.
+ * @param nonblock, return -EAGAIN instead of waiting for a crossing.
+ * @return 0 on success, otherwise errno.
+ */
+int hcsr_thresh_get(hcsr_dev_t *, threshold_event_t *, int);
+
+/**
+ * @brief are there crossings not read yet?
+ * @param devp, a valid device pointer.
+ * @return non-zero when an event is queued.
+ */
+int hcsr_thresh_pending(hcsr_dev_t *);
+
+#endif
@@ -0,0 +1,364 @@
+/**
+ * @file hcsr_trace.c
+ * @brief Edge trace capture and offline replay of hcsr04 devices.
+ *
+ * /sys/kernel/debug/hcsr/<device>/
+ *      trace_enable
+ *              1 captures every round start, trigger, echo edge and result,
+ *              the capture buffer is allocated the first time.
+ *      trace
+ *              read drains the captured hcsr_trace_rec_t records, binary.
+ *      replay
+ *              open for write starts over with the current filter of the
+ *              device, then feed it a captured trace. Every round is run
+ *              through the same edge folding and filter as the sampling
+ *              thread, read shows per round:
+ *              "round widths captured_mm replayed_mm cycles".
+ * 
+ * @author Xiangyu Guo
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/errno.h>
+#include <linux/slab.h>
+#include <linux/fs.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <linux/seq_file.h>
+
+#include <linux/uaccess.h>
+#include <asm/uaccess.h>
+
+#include "defs.h"
+#include "hcsr_conv.h"
+#include "hcsr_trace.h"
+
+#include "utils.h"
+
+#define TRACE_CHUNK     (32)                    /**< Records copied to user at once */
+
+/** One replayed round */
+typedef struct hcsr_replay_round {
+        unsigned int round;                     /**< Number of the round when captured */
+        unsigned int widths;                    /**< Echo widths folded */
+        unsigned long long captured;            /**< Result in mm when captured, 0 if none */
+        unsigned long long replayed;            /**< Result in mm of the replay */
+        unsigned long long cycles;              /**< CPU cost of the replay in TSC cycles */
+} hcsr_replay_round_t;
+
+struct hcsr_replay {
+        sample_data_t sample;                   /**< Round being replayed */
+        hcsr_filter_t filter;                   /**< Filter of the device at open */
+        unsigned int mm_mult;                   /**< Multiplier of the device at open */
+        unsigned int round;                     /**< Number of the round being replayed */
+        int active;                             /**< A round start was seen */
+        unsigned long long cycles;              /**< CPU cost of the round so far */
+        hcsr_trace_rec_t partial;               /**< Record split across writes */
+        size_t partial_len;                     /**< Bytes of the partial record */
+        unsigned int count;                     /**< Rounds replayed */
+        unsigned int dropped;                   /**< Rounds beyond REPLAY_SIZE */
+        hcsr_replay_round_t rounds[REPLAY_SIZE];
+};
+
+int hcsr_trace_init(hcsr_dev_t *devp) {
+        struct hcsr_trace *trace = &devp->trace;
+
+        trace->enabled = 0;
+        spin_lock_init(&trace->lock);
+        mutex_init(&trace->read_lock);
+        mutex_init(&trace->replay_lock);
+        trace->replay = NULL;
+        // Allocated by the first trace_enable, most devices are never traced.
+        trace->records = NULL;
+
+        return 0;
+}
+
+void hcsr_trace_fini(hcsr_dev_t *devp) {
+        devp->trace.enabled = 0;
+        rec_ring_buff_fini(devp->trace.records);
+        devp->trace.records = NULL;
+        kfree(devp->trace.replay);
+        devp->trace.replay = NULL;
+}
+
+void hcsr_trace_record(hcsr_dev_t *devp, unsigned int kind,
+                       unsigned long long tsc, unsigned int value) {
+        hcsr_trace_rec_t rec;
+        unsigned long flags;
+
+        rec.tsc = tsc;
+        rec.kind = kind;
+        rec.value = value;
+
+        // The isr and the thread both produce, one at a time.
+        spin_lock_irqsave(&devp->trace.lock, flags);
+        // Published before the capture was turned on.
+        rec_ring_buff_put(ACCESS_ONCE(devp->trace.records), &rec);
+        spin_unlock_irqrestore(&devp->trace.lock, flags);
+}
+
+static int hcsr_trace_enable_get(void *data, u64 *val) {
+        hcsr_dev_t *devp = data;
+
+        *val = ACCESS_ONCE(devp->trace.enabled);
+        return 0;
+}
+
+static int hcsr_trace_enable_set(void *data, u64 val) {
+        hcsr_dev_t *devp = data;
+        rec_ring_buff_t *records;
+
+        mutex_lock(&devp->trace.read_lock);
+        if (val && devp->trace.records == NULL) {
+                records = rec_ring_buff_init(TRACE_SIZE, sizeof(hcsr_trace_rec_t));
+                if (records == NULL) {
+                        mutex_unlock(&devp->trace.read_lock);
+                        return -ENOMEM;
+                }
+                devp->trace.records = records;
+                // The producers see the records before the capture is on.
+                smp_wmb();
+        }
+        ACCESS_ONCE(devp->trace.enabled) = !!val;
+        mutex_unlock(&devp->trace.read_lock);
+        return 0;
+}
+
+static int hcsr_trace_enable_open(struct inode *inode, struct file *file) {
+        return simple_attr_open(inode, file, hcsr_trace_enable_get,
+                                hcsr_trace_enable_set, "%llu\n");
+}
+
+const struct file_operations hcsr_trace_enable_fops = {
+        .owner = THIS_MODULE,
+        .open = hcsr_trace_enable_open,
+        .release = simple_attr_release,
+        .read = simple_attr_read,
+        .write = simple_attr_write,
+        .llseek = generic_file_llseek,
+};
+
+static int hcsr_trace_open(struct inode *inode, struct file *file) {
+        file->private_data = inode->i_private;
+        return nonseekable_open(inode, file);
+}
+
+static ssize_t hcsr_trace_read(struct file *file, char __user *buf,
+                               size_t count, loff_t *ppos) {
+        hcsr_dev_t *devp = file->private_data;
+        hcsr_trace_rec_t recs[TRACE_CHUNK];
+        size_t done = 0;
+        int n;
+
+        if (mutex_lock_interruptible(&devp->trace.read_lock))
+                return -ERESTARTSYS;
+
+        // Whole records only, until the user buffer is full or the capture empty.
+        while (count - done >= sizeof(hcsr_trace_rec_t)) {
+                n = min_t(size_t, TRACE_CHUNK, (count - done) / sizeof(hcsr_trace_rec_t));
+                n = rec_ring_buff_get_bulk(devp->trace.records, recs, n);
+                if (n <= 0)
+                        break;
+                if (copy_to_user(buf + done, recs, n * sizeof(hcsr_trace_rec_t))) {
+                        mutex_unlock(&devp->trace.read_lock);
+                        return done ? done : -EFAULT;
+                }
+                done += n * sizeof(hcsr_trace_rec_t);
+        }
+
+        mutex_unlock(&devp->trace.read_lock);
+        return done;
+}
+
+const struct file_operations hcsr_trace_fops = {
+        .owner = THIS_MODULE,
+        .open = hcsr_trace_open,
+        .read = hcsr_trace_read,
+        .llseek = no_llseek,
+};
+
+/**
+ * @brief start a new replay round.
+ * @param replay, the replay state.
+ * @param round, number of the round when captured.
+ */
+static void hcsr_replay_start(struct hcsr_replay *replay, unsigned int round) {
+        replay->sample.count = 0;
+        replay->sample.trigger = 0;
+        hcsr_stats_reset(&replay->sample.stats);
+        replay->round = round;
+        replay->cycles = 0;
+        replay->active = 1;
+}
+
+/**
+ * @brief filter the round, like the sampling thread does, and keep the result.
+ * @param replay, the replay state.
+ * @param captured, the result in mm when captured, 0 if none.
+ */
+static void hcsr_replay_finish(struct hcsr_replay *replay, unsigned long long captured) {
+        hcsr_replay_round_t *out;
+        unsigned long long start;
+        unsigned long long width;
+
+        start = rdtsc();
+        width = hcsr_filter_apply(&replay->filter, &replay->sample.stats);
+        replay->cycles += rdtsc() - start;
+        replay->active = 0;
+
+        if (replay->count == REPLAY_SIZE) {
+                replay->dropped++;
+                return;
+        }
+
+        out = &replay->rounds[replay->count++];
+        out->round = replay->round;
+        out->widths = replay->sample.stats.count;
+        out->captured = captured;
+        out->replayed = hcsr_conv_to_mm(width, replay->mm_mult);
+        out->cycles = replay->cycles;
+}
+
+/**
+ * @brief feed one captured record to the replay.
+ * @param replay, the replay state.
+ * @param rec, the record.
+ */
+static void hcsr_replay_feed(struct hcsr_replay *replay, const hcsr_trace_rec_t *rec) {
+        unsigned long long start;
+
+        switch (rec->kind) {
+                case HCSR_TRACE_ROUND:
+                        // A round cut short has no captured result.
+                        if (replay->active)
+                                hcsr_replay_finish(replay, 0);
+                        hcsr_replay_start(replay, rec->value);
+                        break;
+                case HCSR_TRACE_TRIGGER:
+                        replay->sample.trigger = rec->tsc;
+                        break;
+                case HCSR_TRACE_EDGE:
+                        // The capture may begin in the middle of a round.
+                        if (!replay->active)
+                                break;
+                        start = rdtsc();
+                        hcsr_sample_edge(&replay->sample, rec->tsc);
+                        replay->cycles += rdtsc() - start;
+                        break;
+                case HCSR_TRACE_RESULT:
+                        if (replay->active)
+                                hcsr_replay_finish(replay, rec->value);
+                        break;
+                default:
+                        break;
+        }
+}
+
+/**
+ * @brief print the replayed rounds.
+ * @param m, the seq file.
+ * @param v, unused.
+ * @return 0.
+ */
+static int hcsr_replay_show(struct seq_file *m, void *v) {
+        hcsr_dev_t *devp = m->private;
+        struct hcsr_replay *replay;
+        hcsr_replay_round_t *out;
+        unsigned int i;
+
+        mutex_lock(&devp->trace.replay_lock);
+        replay = devp->trace.replay;
+        if (replay == NULL) {
+                mutex_unlock(&devp->trace.replay_lock);
+                return 0;
+        }
+
+        for (i = 0; i < replay->count; ++i) {
+                out = &replay->rounds[i];
+                seq_printf(m, "%u %u %llu %llu %llu\n", out->round, out->widths,
+                           out->captured, out->replayed, out->cycles);
+        }
+        if (replay->dropped)
+                seq_printf(m, "dropped %u\n", replay->dropped);
+        mutex_unlock(&devp->trace.replay_lock);
+        return 0;
+}
+
+/**
+ * @brief start the replay over with the current filter of the device.
+ * @param devp, a valid device pointer.
+ * @return 0 on success, otherwise errno.
+ */
+static int hcsr_replay_reset(hcsr_dev_t *devp) {
+        struct hcsr_replay *replay;
+
+        mutex_lock(&devp->trace.replay_lock);
+        replay = devp->trace.replay;
+        if (replay == NULL) {
+                replay = kmalloc(sizeof(struct hcsr_replay), GFP_KERNEL);
+                if (replay == NULL) {
+                        mutex_unlock(&devp->trace.replay_lock);
+                        return -ENOMEM;
+                }
+                devp->trace.replay = replay;
+        }
+
+        memset(replay, 0, sizeof(struct hcsr_replay));
+        // Tracker state starts fresh, like after SET_FILTER.
+        hcsr_filter_init(&replay->filter, &devp->filter.setting);
+        replay->mm_mult = devp->settings.mm_mult;
+        mutex_unlock(&devp->trace.replay_lock);
+        return 0;
+}
+
+static int hcsr_replay_open(struct inode *inode, struct file *file) {
+        int ret;
+
+        if (file->f_mode & FMODE_WRITE) {
+                ret = hcsr_replay_reset(inode->i_private);
+                if (ret)
+                        return ret;
+        }
+        return single_open(file, hcsr_replay_show, inode->i_private);
+}
+
+static ssize_t hcsr_replay_write(struct file *file, const char __user *buf,
+                                 size_t count, loff_t *ppos) {
+        hcsr_dev_t *devp = ((struct seq_file *)file->private_data)->private;
+        struct hcsr_replay *replay;
+        size_t done = 0;
+        size_t n;
+
+        mutex_lock(&devp->trace.replay_lock);
+        replay = devp->trace.replay;
+
+        while (done < count) {
+                // Records may be split across writes, e.g. through a pipe.
+                n = min(count - done, sizeof(hcsr_trace_rec_t) - replay->partial_len);
+                if (copy_from_user((char *)&replay->partial + replay->partial_len,
+                                   buf + done, n)) {
+                        mutex_unlock(&devp->trace.replay_lock);
+                        return done ? done : -EFAULT;
+                }
+                done += n;
+                replay->partial_len += n;
+                if (replay->partial_len < sizeof(hcsr_trace_rec_t))
+                        break;
+
+                hcsr_replay_feed(replay, &replay->partial);
+                replay->partial_len = 0;
+        }
+
+        mutex_unlock(&devp->trace.replay_lock);
+        return done;
+}
+
+const struct file_operations hcsr_replay_fops = {
+        .owner = THIS_MODULE,
+        .open = hcsr_replay_open,
+        .read = seq_read,
+        .write = hcsr_replay_write,
+        .llseek = seq_lseek,
+        .release = single_release,
+};
@@ -0,0 +1,80 @@
+/**
+ * @file hcsr_trace.h
+ * @brief Edge trace capture and offline replay of hcsr04 devices.
+ * 
+ * @author Xiangyu Guo
+ */
+#ifndef __HCSR_TRACE_H__
+#define __HCSR_TRACE_H__
+
+#include <linux/compiler.h>
+#include <linux/fs.h>
+
+#include "defs.h"
+
+#define TRACE_SIZE      (4095)                  /**< Captured records kept, one spare slot makes 4096 */
+#define REPLAY_SIZE     (256)                   /**< Replayed rounds kept for the reader */
+
+/** debugfs <device>/trace_enable, the capture is allocated when first enabled */
+extern const struct file_operations hcsr_trace_enable_fops;
+
+/** debugfs <device>/trace, read drains the captured records */
+extern const struct file_operations hcsr_trace_fops;
+
+/** debugfs <device>/replay, write records in, read the rounds out */
+extern const struct file_operations hcsr_replay_fops;
+
+/**
+ * @brief fold one echo edge into the round, rising and falling by turns.
+ * @param sample, the round in progress.
+ * @param tsc, time stamp of the edge.
+ * @return 1 for a falling edge, the width is added; 0 for a rising one.
+ * @note shared by the isr and the replay, so both see the same widths.
+ */
+static inline int hcsr_sample_edge(sample_data_t *sample, unsigned long long tsc) {
+        if (sample->count++ & 1) {
+                hcsr_stats_add(&sample->stats, tsc - sample->rise);
+                sample->fall = tsc;
+                return 1;
+        }
+        sample->rise = tsc;
+        return 0;
+}
+
+/**
+ * @brief initialize the capture of a device, capture off and not allocated.
+ * @param devp, a valid device pointer.
+ * @return 0 on success, otherwise errno.
+ */
+int hcsr_trace_init(hcsr_dev_t *);
+
+/**
+ * @brief release the capture and the replay of a device.
+ * @param devp, a valid device pointer.
+ */
+void hcsr_trace_fini(hcsr_dev_t *);
+
+/**
+ * @brief append one record to the capture.
+ * @param devp, a valid device pointer.
+ * @param kind, enum hcsr_trace_kind.
+ * @param tsc, time stamp of the record.
+ * @param value, meaning depends on the kind.
+ * @note safe to call from the isr, the oldest records are overwritten.
+ */
+void hcsr_trace_record(hcsr_dev_t *, unsigned int, unsigned long long, unsigned int);
+
+/**
+ * @brief append one record when the capture is on.
+ * @param devp, a valid device pointer.
+ * @param kind, enum hcsr_trace_kind.
+ * @param tsc, time stamp of the record.
+ * @param value, meaning depends on the kind.
+ */
+static inline void hcsr_trace_add(hcsr_dev_t *devp, unsigned int kind,
+                                  unsigned long long tsc, unsigned int value) {
+        if (unlikely(ACCESS_ONCE(devp->trace.enabled)))
+                hcsr_trace_record(devp, kind, tsc, value);
+}
+
+#endif
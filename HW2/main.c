@@ -59,7 +59,7 @@ void test_suites_two(int idx) {
     } else {
         printf("Passed!\n");
     }
-    printf("Distance %llu(centi-meter)\n", r.measurement);
+    printf("Distance %llu(milli-meter)\n", r.measurement);
 
     printf("Testing on write more than 5 times....\n");
     for (i = 0; i < 6; ++i) {
@@ -80,7 +80,7 @@ void test_suites_two(int idx) {
     } else {
         printf("Passed!\n");
     }
-    printf("Distance %llu(centi-meter)\n", r.measurement);
+    printf("Distance %llu(milli-meter)\n", r.measurement);
 
     printf("Testing on write more than 5 times with non-zero value....\n");
     for (i = 0; i < 6; ++i) {
@@ -102,7 +102,7 @@ void test_suites_two(int idx) {
         printf("Passed!\n");
     }
 
-    printf("Distance %llu(centi-meter)\n", r.measurement);
+    printf("Distance %llu(milli-meter)\n", r.measurement);
 }
 
 void test_suites_three(int idx) {
@@ -153,7 +153,7 @@ void test_suites_three(int idx) {
     } else {
         printf("Passed!\n");
     }
-    printf("Distance %llu(centi-meter)\n", r.measurement);
+    printf("Distance %llu(milli-meter)\n", r.measurement);
 }
 
 int main(int argc, char const *argv[])
@@ -4,6 +4,9 @@
  * @author Xiangyu Guo
  */
 #include <linux/slab.h>
+#include <linux/log2.h>
+#include <linux/string.h>
+#include <asm/barrier.h>
 
 #include "ring_buff.h"
 
@@ -16,6 +19,27 @@ struct mp_ring_buff {
         void **data;                    /**< Ring buffer */
 };
 
+struct rec_ring_buff {
+        unsigned int head;              /**< Next record to read, consumer owned */
+        unsigned int tail;              /**< Next record to write, producer owned */
+        unsigned int buff_size;         /**< Records kept before overwriting */
+        unsigned int mask;              /**< Slot mask, slots are power of two */
+        unsigned int rec_size;          /**< Record size in bytes */
+        unsigned long overwritten;      /**< Records overwritten unread, producer owned */
+        unsigned long discarded;        /**< Records removed unread, consumer owned */
+        char *data;                     /**< Record storage */
+};
+
+/**
+ * @brief address of the slot holding the record with the given index.
+ * @param obj, a valid ring buffer object.
+ * @param idx, free running record index.
+ * @return pointer to the slot.
+ */
+static inline void *rec_ring_buff_slot(rec_ring_buff_t *obj, unsigned int idx) {
+        return obj->data + (idx & obj->mask) * obj->rec_size;
+}
+
 /**
  * @brief ring buffer is empty or not
  * @param obj, a valid ring buffer object.
@@ -152,4 +176,156 @@ static int ring_buff_is_empty(mp_ring_buff_t *obj) {
 
 static int ring_buff_is_full(mp_ring_buff_t *obj) {
         return (obj->tail + 1) % obj->buff_size == obj->head;
-}
\ No newline at end of file
+}
+/* ==================== Inline record ring buffer ============================*/
+
+rec_ring_buff_t *rec_ring_buff_init(unsigned int buff_size, unsigned int rec_size) {
+        rec_ring_buff_t *obj;
+        unsigned int slots;
+
+        if (buff_size == 0 || rec_size == 0)
+                return NULL;
+
+        obj = kmalloc(sizeof(rec_ring_buff_t), GFP_KERNEL);
+        if (obj == NULL) {
+                printk(KERN_ALERT "No mem\n");
+                return NULL;
+        }
+        // One spare slot for the record the producer is writing.
+        slots = roundup_pow_of_two(buff_size + 1);
+
+        obj->head = 0;
+        obj->tail = 0;
+        obj->buff_size = buff_size;
+        obj->mask = slots - 1;
+        obj->rec_size = rec_size;
+        obj->overwritten = 0;
+        obj->discarded = 0;
+        obj->data = kzalloc(slots * rec_size, GFP_KERNEL);
+        if (obj->data == NULL) {
+                kfree(obj);
+                return NULL;
+        }
+
+        return obj;
+}
+
+void rec_ring_buff_fini(rec_ring_buff_t *obj) {
+        if (obj == NULL)
+                return;
+
+        kfree(obj->data);
+        kfree(obj);
+}
+
+int rec_ring_buff_removeall(rec_ring_buff_t *obj) {
+        unsigned int tail;
+
+        if (obj == NULL)
+                return -EINVAL;
+
+        tail = smp_load_acquire(&obj->tail);
+        // Records beyond buff_size are counted by the producer already.
+        obj->discarded += min(tail - obj->head, obj->buff_size);
+        obj->head = tail;
+        return 0;
+}
+
+unsigned int rec_ring_buff_count(rec_ring_buff_t *obj) {
+        unsigned int count;
+
+        if (obj == NULL)
+                return 0;
+
+        count = smp_load_acquire(&obj->tail) - ACCESS_ONCE(obj->head);
+        return min(count, obj->buff_size);
+}
+
+unsigned long rec_ring_buff_dropped(rec_ring_buff_t *obj) {
+        if (obj == NULL)
+                return 0;
+
+        return ACCESS_ONCE(obj->overwritten) + ACCESS_ONCE(obj->discarded);
+}
+
+int rec_ring_buff_put(rec_ring_buff_t *obj, const void *rec) {
+        int ret;
+
+        ret = rec_ring_buff_put_bulk(obj, rec, 1);
+        return ret < 0 ? ret : 0;
+}
+
+int rec_ring_buff_put_bulk(rec_ring_buff_t *obj, const void *recs, unsigned int n) {
+        const char *src = recs;
+        unsigned int tail;
+        unsigned int i;
+
+        if (obj == NULL || recs == NULL)
+                return -EINVAL;
+
+        // Records older than buff_size would be overwritten right away.
+        if (n > obj->buff_size) {
+                obj->overwritten += n - obj->buff_size;
+                src += (n - obj->buff_size) * obj->rec_size;
+                n = obj->buff_size;
+        }
+
+        tail = obj->tail;
+        for (i = 0; i < n; ++i) {
+                // Full, this record pushes out the oldest one unread.
+                if (tail - ACCESS_ONCE(obj->head) >= obj->buff_size)
+                        obj->overwritten++;
+                memcpy(rec_ring_buff_slot(obj, tail), src, obj->rec_size);
+                src += obj->rec_size;
+                // Publish the record only after it is completely written.
+                smp_store_release(&obj->tail, ++tail);
+                // And before the next slot is touched, pairs with smp_rmb in
+                // rec_ring_buff_get_bulk so a torn copy always sees this tail.
+                smp_wmb();
+        }
+
+        return n;
+}
+
+int rec_ring_buff_get(rec_ring_buff_t *obj, void *rec) {
+        int ret;
+
+        ret = rec_ring_buff_get_bulk(obj, rec, 1);
+        if (ret < 0)
+                return ret;
+
+        return ret ? 0 : -EINVAL;
+}
+
+int rec_ring_buff_get_bulk(rec_ring_buff_t *obj, void *recs, unsigned int n) {
+        unsigned int head;
+        unsigned int tail;
+        unsigned int count;
+        unsigned int i;
+        char *dst;
+
+        if (obj == NULL || recs == NULL)
+                return -EINVAL;
+
+        do {
+                tail = smp_load_acquire(&obj->tail);
+                head = obj->head;
+                // Producer lapped us, skip the overwritten records.
+                if (tail - head > obj->buff_size)
+                        head = tail - obj->buff_size;
+
+                count = min(n, tail - head);
+                dst = recs;
+                for (i = 0; i < count; ++i) {
+                        memcpy(dst, rec_ring_buff_slot(obj, head + i), obj->rec_size);
+                        dst += obj->rec_size;
+                }
+
+                // The copy is only good if the producer did not reach the
+                // oldest slot we read from in the meantime.
+                smp_rmb();
+        } while (ACCESS_ONCE(obj->tail) - head > obj->mask);
+
+        obj->head = head + count;
+        return count;
+}
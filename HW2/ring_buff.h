@@ -9,6 +9,9 @@ struct mp_ring_buff;
 
 typedef void (*free_func)(const void *);        /**< Release function pointer */
 
+typedef struct rec_ring_buff rec_ring_buff_t;
+struct rec_ring_buff;
+
 /**
  * @brief create a ring buffer object
  * @param buff_size, the buffer size you want.
@@ -72,4 +75,89 @@ int ring_buff_get(mp_ring_buff_t *, void **);
  */
 int ring_buff_get_nolock(mp_ring_buff_t *, void **);
 
+/* ==================== Inline record ring buffer ============================
+ * Fixed-size records are stored by value in one preallocated array.
+ * Single producer / single consumer, no lock: the producer only moves the
+ * tail, the consumer only moves the head. When the buffer is full the
+ * producer keeps writing and the oldest records are overwritten; the
+ * consumer notices and skips over them.
+ * Several consumers (or a consumer racing with removeall) must serialize
+ * among themselves.
+ *============================================================================*/
+
+/**
+ * @brief create an inline record ring buffer object
+ * @param buff_size, the number of records the buffer holds.
+ * @param rec_size, the size of one record in bytes.
+ * @return NULL on failed; otherwise a valid pointer to the object.
+ */
+rec_ring_buff_t *rec_ring_buff_init(unsigned int, unsigned int);
+
+/**
+ * @brief release an inline record ring buffer object
+ * @param obj, a valid ring buffer object.
+ */
+void rec_ring_buff_fini(rec_ring_buff_t *);
+
+/**
+ * @brief drop all records in the ring buffer.
+ * @param obj, a valid ring buffer object.
+ * @return 0, on success; otherwise errno.
+ * @note consumer side operation, the records count as dropped.
+ */
+int rec_ring_buff_removeall(rec_ring_buff_t *);
+
+/**
+ * @brief number of records waiting in the ring buffer.
+ * @param obj, a valid ring buffer object.
+ * @return the number of records, at most buff_size.
+ */
+unsigned int rec_ring_buff_count(rec_ring_buff_t *);
+
+/**
+ * @brief number of records lost before the consumer got them.
+ * @param obj, a valid ring buffer object.
+ * @return the number of records overwritten by the producer when full,
+ *         or removed by removeall.
+ */
+unsigned long rec_ring_buff_dropped(rec_ring_buff_t *);
+
+/**
+ * @brief copy one record into the ring buffer, overwrite the oldest if full.
+ * @param obj, a valid ring buffer object.
+ * @param rec, a pointer to the record.
+ * @return 0, on success; otherwise errno.
+ * @note producer side operation.
+ */
+int rec_ring_buff_put(rec_ring_buff_t *, const void *);
+
+/**
+ * @brief copy n records into the ring buffer, overwrite the oldest if full.
+ * @param obj, a valid ring buffer object.
+ * @param recs, a pointer to an array of records.
+ * @param n, the number of records in the array.
+ * @return the number of records put; otherwise errno.
+ * @note producer side operation.
+ */
+int rec_ring_buff_put_bulk(rec_ring_buff_t *, const void *, unsigned int);
+
+/**
+ * @brief copy one record out of the ring buffer.
+ * @param obj, a valid ring buffer object.
+ * @param rec, a pointer to the record storage.
+ * @return 0, on success; otherwise errno.
+ * @note consumer side operation.
+ */
+int rec_ring_buff_get(rec_ring_buff_t *, void *);
+
+/**
+ * @brief copy up to n records out of the ring buffer, oldest first.
+ * @param obj, a valid ring buffer object.
+ * @param recs, a pointer to an array of record storage.
+ * @param n, the capacity of the array in records.
+ * @return the number of records copied (0 on empty); otherwise errno.
+ * @note consumer side operation.
+ */
+int rec_ring_buff_get_bulk(rec_ring_buff_t *, void *, unsigned int);
+
 #endif
\ No newline at end of file
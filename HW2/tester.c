@@ -13,11 +13,16 @@
 #include <time.h>
 
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <poll.h>
 
 #include "common.h"
 
 #define BUFF_SIZE (1024)            /**< Default buffer size */
 #define MAX_DEVICES (10)            /**< Max device going to support */
+#define MAX_RESULTS (16)            /**< Max results per read in stream mode */
+#define CONTROL_PATH "/dev/HCSR_ctl"    /**< Control node of all devices */
 
 static void usage() {
     printf("===============================================================\n");
@@ -26,6 +31,15 @@ static void usage() {
     printf("|        write: ./tester <dev> write <integer_value>          |\n");
     printf("|        pins : ./tester <dev> pins <trigger_pin> <echo_pin>  |\n");
     printf("|        param: ./tester <dev> param <m_samples> <delta>      |\n");
+    printf("|        wmark: ./tester <dev> wmark <results>                |\n");
+    printf("|        stream: ./tester <dev> stream                        |\n");
+    printf("|        mmap : ./tester <dev> mmap                           |\n");
+    printf("|        filter: ./tester <dev> filter <type> <trim>          |\n");
+    printf("|        evfd : ./tester <dev> evfd <every_nth_result>        |\n");
+    printf("|        cached: ./tester <dev> cached <max_age_ms>           |\n");
+    printf("|        trigall: ./tester <dev> trigall                      |\n");
+    printf("|        snap : ./tester <dev> snap                           |\n");
+    printf("|        thresh: ./tester <dev> thresh <near> <far> <hyst> <n>|\n");
     printf("|    More Instructions see README                             |\n");
     printf("|       Contact: Xiangyu.Guo@asu.edu                          |\n");
     printf("===============================================================\n");
@@ -69,7 +83,8 @@ int main(int argc, char const *argv[]) {
         }
 
         printf("%d %llu %llu\n", ret, r.measurement, r.timestamp);
-        printf("Distance %llu(centi-meter)\n", r.measurement);
+        printf("Distance %llu(milli-meter)\n", r.measurement);
+        printf("Samples %u Variance %llu(mm^2)\n", r.samples, r.variance);
     } else if (strcmp("write", argv[2]) == 0) {
         int value;
         if (argc < 4) {
@@ -116,6 +131,199 @@ int main(int argc, char const *argv[]) {
             printf("Setup params error, %s\n", strerror(errno));
             return errno;
         }
+    } else if (strcmp("wmark", argv[2]) == 0) {
+        unsigned int watermark;
+
+        if (argc < 4) {
+            usage();
+            return EINVAL;
+        }
+
+        watermark = atoi(argv[3]);
+
+        if (ioctl(fd[idx], SET_WATERMARK, &watermark)) {
+            printf("Setup watermark error, %s\n", strerror(errno));
+            return errno;
+        }
+    } else if (strcmp("filter", argv[2]) == 0) {
+        filter_setting_t f;
+
+        if (argc < 5) {
+            usage();
+            return EINVAL;
+        }
+
+        f.type = atoi(argv[3]);
+        f.trim = atoi(argv[4]);
+        f.alpha = HCSR_FILTER_ONE / 2;
+        f.beta = HCSR_FILTER_ONE / 8;
+
+        if (ioctl(fd[idx], SET_FILTER, &f)) {
+            printf("Setup filter error, %s\n", strerror(errno));
+            return errno;
+        }
+    } else if (strcmp("stream", argv[2]) == 0) {
+        result_info_t r[MAX_RESULTS];
+        int i;
+
+        while (1) {
+            ret = read(fd[idx], r, sizeof(r));
+            if (ret < 0) {
+                printf("No data\n");
+                return errno;
+            }
+
+            for (i = 0; i < ret / (int)sizeof(result_info_t); ++i) {
+                printf("%llu Distance %llu(milli-meter)\n", r[i].timestamp, r[i].measurement);
+            }
+        }
+    } else if (strcmp("mmap", argv[2]) == 0) {
+        size_t len = HCSR_MMAP_HDR + HCSR_MMAP_SLOTS * sizeof(result_info_t);
+        hcsr_mmap_header_t *hdr;
+        result_info_t *slots;
+        struct pollfd pfd;
+        unsigned int tail;
+        unsigned int seq;
+        result_info_t r;
+
+        hdr = mmap(NULL, len, PROT_READ, MAP_SHARED, fd[idx], 0);
+        if (hdr == MAP_FAILED) {
+            printf("mmap error, %s\n", strerror(errno));
+            return errno;
+        }
+        slots = (result_info_t *)((char *)hdr + hdr->offset);
+        tail = hdr->head;
+
+        pfd.fd = fd[idx];
+        pfd.events = POLLIN;
+        while (poll(&pfd, 1, -1) > 0) {
+            while (tail != hdr->head) {
+                do {
+                    seq = hdr->seq;
+                    __sync_synchronize();
+                    // Fell behind a ring, skip to the oldest kept. Slot
+                    // head - slots is the next one written, never read it.
+                    if (hdr->head - tail >= hdr->slots)
+                        tail = hdr->head - hdr->slots + 1;
+                    r = slots[tail & (hdr->slots - 1)];
+                    __sync_synchronize();
+                } while ((seq & 1) || seq != hdr->seq);
+
+                printf("%u %llu Distance %llu(milli-meter)\n", tail, r.timestamp, r.measurement);
+                tail++;
+            }
+            // Otherwise poll keeps reporting the results taken.
+            if (ioctl(fd[idx], ACK_MMAP, &tail)) {
+                printf("Ack mmap error, %s\n", strerror(errno));
+                break;
+            }
+        }
+        munmap(hdr, len);
+    } else if (strcmp("cached", argv[2]) == 0) {
+        unsigned int max_age;
+        result_info_t r;
+
+        if (argc < 4) {
+            usage();
+            return EINVAL;
+        }
+
+        // The read mode belongs to this open file only.
+        max_age = atoi(argv[3]);
+        if (ioctl(fd[idx], SET_MAX_AGE, &max_age)) {
+            printf("Setup max age error, %s\n", strerror(errno));
+            return errno;
+        }
+
+        while (1) {
+            ret = read(fd[idx], &r, sizeof(result_info_t));
+            if (ret < 0) {
+                printf("No data\n");
+                return errno;
+            }
+
+            printf("%llu Distance %llu(milli-meter)\n", r.timestamp, r.measurement);
+            usleep(50 * 1000);
+        }
+    } else if (strcmp("evfd", argv[2]) == 0) {
+        eventfd_setting_t e;
+        eventfd_t value;
+
+        if (argc < 4) {
+            usage();
+            return EINVAL;
+        }
+
+        e.fd = eventfd(0, 0);
+        e.every = atoi(argv[3]);
+        if (e.fd < 0 || ioctl(fd[idx], SET_EVENTFD, &e)) {
+            printf("Setup eventfd error, %s\n", strerror(errno));
+            return errno;
+        }
+
+        // Someone else keeps the device sampling, e.g. write 1.
+        while (eventfd_read(e.fd, &value) == 0) {
+            printf("Signaled %llu\n", (unsigned long long)value);
+        }
+        close(e.fd);
+    } else if (strcmp("thresh", argv[2]) == 0) {
+        threshold_setting_t t;
+        threshold_event_t e;
+        struct pollfd pfd;
+        static const char *zones[] = {"middle", "near", "far"};
+
+        if (argc < 7) {
+            usage();
+            return EINVAL;
+        }
+
+        t.near = atoi(argv[3]);
+        t.far = atoi(argv[4]);
+        t.hysteresis = atoi(argv[5]);
+        t.debounce = atoi(argv[6]);
+        if (ioctl(fd[idx], SET_THRESHOLD, &t)) {
+            printf("Setup threshold error, %s\n", strerror(errno));
+            return errno;
+        }
+
+        // Someone else keeps the device sampling, e.g. write 1.
+        pfd.fd = fd[idx];
+        pfd.events = POLLPRI;
+        while (poll(&pfd, 1, -1) > 0) {
+            if (ioctl(fd[idx], GET_EVENT, &e))
+                continue;
+            printf("%llu %s -> %s Distance %llu(milli-meter)\n", e.result.timestamp,
+                   zones[e.from], zones[e.zone], e.result.measurement);
+        }
+    } else if (strcmp("trigall", argv[2]) == 0 || strcmp("snap", argv[2]) == 0) {
+        hcsr_snapshot_t snap;
+        unsigned int i;
+        int ctl;
+
+        ctl = open(CONTROL_PATH, O_RDWR);
+        if (ctl < 0) {
+            printf("Open %s error, %s\n", CONTROL_PATH, strerror(errno));
+            return errno;
+        }
+
+        if (strcmp("trigall", argv[2]) == 0) {
+            ret = ioctl(ctl, TRIGGER_ALL);
+            if (ret < 0) {
+                printf("Trigger all error, %s\n", strerror(errno));
+                return errno;
+            }
+            printf("Started %d sensors\n", ret);
+        } else {
+            if (ioctl(ctl, GET_SNAPSHOT, &snap)) {
+                printf("Snapshot error, %s\n", strerror(errno));
+                return errno;
+            }
+            for (i = 0; i < snap.count; ++i) {
+                printf("%s %llu Distance %llu(milli-meter)\n", snap.sensors[i].name,
+                       snap.sensors[i].result.timestamp, snap.sensors[i].result.measurement);
+            }
+        }
+        close(ctl);
     } else if (strcmp("fun", argv[2]) == 0) {
         result_info_t r;
 
@@ -126,7 +334,7 @@ int main(int argc, char const *argv[]) {
                 return errno;
             }
 
-            printf("Distance %llu(centi-meter)\n", r.measurement);
+            printf("Distance %llu(milli-meter)\n", r.measurement);
         }
     } else {
         usage();
@@ -18,6 +18,9 @@
 #define GENL_HB_FAMILY_NAME       "genl_hb"
 
 #define GENL_HB_ATTR_MSG_MAX      256
+#define GENL_HB_MAX_CHAIN         8         /**< Most cascaded MAX7219s on one chip select */
+#define GENL_HB_MAX_FRAMES        16        /**< Most frames in an animation sequence */
+#define GENL_HB_RATE_NORMAL       100       /**< Playback rate as uploaded, in percent */
 
 /** Message types */
 enum {
@@ -25,6 +28,8 @@ enum {
     GENL_HB_CONFIG_MSG,         /**< Pin configuration message */
     GENL_HB_MEASURE_MSG,        /**< Distance measurement message */
     GENL_HB_DISPLAY_MSG,        /**< Pattern display message */
+    GENL_HB_SEQUENCE_MSG,       /**< Animation upload message, count 0 stops */
+    GENL_HB_RATE_MSG,           /**< Playback rate message, GENL_HB_ATTR_RATE */
 };
 
 /** Generic netlink attributes */
@@ -32,6 +37,8 @@ enum genl_hb_attrs {
     GENL_HB_ATTR_UNSPEC,        /**< Must NOT use element 0 */
     GENL_HB_ATTR_MSG,           /**< Only one attribute, message */
     GENL_HB_ATTR_DIS,           /**< Distance result, u64 */
+    GENL_HB_ATTR_SEQ,           /**< Animation sequence, genl_hb_sequence_t */
+    GENL_HB_ATTR_RATE,          /**< Playback rate in percent, u32 */
     __GENL_HB_ATTR__MAX,
 };
 #define GENL_HB_ATTR_MAX (__GENL_HB_ATTR__MAX - 1)
@@ -40,12 +47,26 @@ typedef struct genl_hb_pins {
     int chip_select;
     int trigger;
     int echo;
+    int chain;                  /**< Cascaded MAX7219s on chip_select, 1 if left out */
 } genl_hb_pins_t;
 
+/** One 8x8 matrix, a display message carries one per chip of the chain, nearest first */
 typedef struct genl_hb_pattern {
     uint8_t led[8];
 } genl_hb_pattern_t;
 
+typedef struct genl_hb_frame {
+    uint32_t duration;                              /**< Time on the display in ms, at normal rate */
+    genl_hb_pattern_t pattern[GENL_HB_MAX_CHAIN];   /**< One per matrix of the chain, nearest first */
+} genl_hb_frame_t;
+
+/** Animation played by the kernel, frame after frame, loops times */
+typedef struct genl_hb_sequence {
+    uint32_t count;                                 /**< Frames in use, 0 stops the playback */
+    uint32_t loops;                                 /**< Plays of the whole sequence, 0 forever */
+    genl_hb_frame_t frames[GENL_HB_MAX_FRAMES];
+} genl_hb_sequence_t;
+
 static struct nla_policy genl_hb_policy[GENL_HB_ATTR_MAX+1] = {
         [GENL_HB_ATTR_MSG] = {
                 .type = NLA_STRING,
@@ -61,6 +82,15 @@ static struct nla_policy genl_hb_policy[GENL_HB_ATTR_MAX+1] = {
 #else
                 .maxlen = GENL_HB_ATTR_MSG_MAX
 #endif
+        },[GENL_HB_ATTR_SEQ] = {
+                .type = NLA_BINARY,
+#ifdef __KERNEL__
+                .len = sizeof(genl_hb_sequence_t)
+#else
+                .maxlen = sizeof(genl_hb_sequence_t)
+#endif
+        },[GENL_HB_ATTR_RATE] = {
+                .type = NLA_U32,
         },
 };
 
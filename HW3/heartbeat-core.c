@@ -11,6 +11,7 @@
  */
 #include <linux/module.h>
 #include <linux/gpio.h>
+#include <linux/slab.h>
 
 #include <net/genetlink.h>
 
@@ -18,6 +19,7 @@
 #include "gpio_config.h"
 #include "max7219.h"
 #include "hcsr_drv.h"
+#include "sequencer.h"
 
 static struct hcsr_dev hcsr04_sensor;           /**< HCSR04 sensor for distance measurement */
 
@@ -47,6 +49,22 @@ static int genl_hb_rx_measure_msg(struct sk_buff* skb, struct genl_info* info);
  */
 static int genl_hb_rx_display_msg(struct sk_buff* skb, struct genl_info* info);
 
+/**
+ * @brief heartbeat animation upload [input] message.
+ * @param skb, socket buffer.
+ * @param info, generic netlink info.
+ * @param return 0 on success, otherwise failed.
+ */
+static int genl_hb_rx_sequence_msg(struct sk_buff* skb, struct genl_info* info);
+
+/**
+ * @brief heartbeat playback rate [input] message.
+ * @param skb, socket buffer.
+ * @param info, generic netlink info.
+ * @param return 0 on success, otherwise failed.
+ */
+static int genl_hb_rx_rate_msg(struct sk_buff* skb, struct genl_info* info);
+
 /**
  * @brief heartbeat distance [output] message.
  * @param data, the data pass through the callback.
@@ -70,6 +88,16 @@ static const struct genl_ops genl_hb_ops[] = {
                 .policy = genl_hb_policy,
                 .doit = genl_hb_rx_display_msg,
                 .dumpit = NULL,
+        }, {
+                .cmd = GENL_HB_SEQUENCE_MSG,
+                .policy = genl_hb_policy,
+                .doit = genl_hb_rx_sequence_msg,
+                .dumpit = NULL,
+        }, {
+                .cmd = GENL_HB_RATE_MSG,
+                .policy = genl_hb_policy,
+                .doit = genl_hb_rx_rate_msg,
+                .dumpit = NULL,
         },
 };
 
@@ -87,6 +115,7 @@ static struct genl_family genl_hb_family = {
 static int genl_hb_rx_pin_config_msg(struct sk_buff* skb, struct genl_info* info)
 {
         int ret;
+        int err;
         genl_hb_pins_t pins;
         if (!info->attrs[GENL_HB_ATTR_MSG]) {
                 printk(KERN_ERR "empty message from %d!!\n", info->snd_portid);
@@ -96,9 +125,15 @@ static int genl_hb_rx_pin_config_msg(struct sk_buff* skb, struct genl_info* info
 
         printk(KERN_INFO "length:%d\n", nla_len(info->attrs[GENL_HB_ATTR_MSG]));
 
-        memcpy(&pins, nla_data(info->attrs[GENL_HB_ATTR_MSG]), sizeof(genl_hb_pins_t));
-        printk(KERN_NOTICE "%u says chip_select:%d trigger:%d echo:%d\n", info->snd_portid,
-                                pins.chip_select, pins.trigger, pins.echo);
+        // Older senders leave the chain out, a single matrix.
+        pins.chain = 1;
+        memcpy(&pins, nla_data(info->attrs[GENL_HB_ATTR_MSG]),
+               min_t(int, nla_len(info->attrs[GENL_HB_ATTR_MSG]), sizeof(genl_hb_pins_t)));
+        printk(KERN_NOTICE "%u says chip_select:%d trigger:%d echo:%d chain:%d\n", info->snd_portid,
+                                pins.chip_select, pins.trigger, pins.echo, pins.chain);
+
+        if (pins.chain < 1 || pins.chain > GENL_HB_MAX_CHAIN)
+                return -EINVAL;
 
         if (hcsr_lock(&hcsr04_sensor))
                 return -EBUSY;
@@ -161,7 +196,10 @@ static int genl_hb_rx_pin_config_msg(struct sk_buff* skb, struct genl_info* info
         }
         hcsr_unlock(&hcsr04_sensor);
 
-        max7219_device_config(s_pins.chip_select);
+        // The irq error comes first, otherwise report a failed display setup.
+        err = max7219_device_config(s_pins.chip_select, pins.chain);
+        if (ret == 0)
+                ret = err;
         //[ToDo] unlock Max7219
         return ret;
 }
@@ -194,7 +232,8 @@ static int genl_hb_rx_measure_msg(struct sk_buff* skb, struct genl_info* info) {
 }
 
 static int genl_hb_rx_display_msg(struct sk_buff* skb, struct genl_info* info) {
-        genl_hb_pattern_t pattern;
+        genl_hb_pattern_t pattern[GENL_HB_MAX_CHAIN];
+        int length;
 
         if (!info->attrs[GENL_HB_ATTR_MSG]) {
                 printk(KERN_ERR "empty message from %d!!\n", info->snd_portid);
@@ -204,13 +243,45 @@ static int genl_hb_rx_display_msg(struct sk_buff* skb, struct genl_info* info) {
 
         printk(KERN_INFO "length:%d\n", nla_len(info->attrs[GENL_HB_ATTR_MSG]));
 
-        memcpy(&pattern, nla_data(info->attrs[GENL_HB_ATTR_MSG]), sizeof(genl_hb_pattern_t));
+        // One pattern per chip of the chain.
+        length = min_t(int, nla_len(info->attrs[GENL_HB_ATTR_MSG]), sizeof(pattern));
+        memcpy(pattern, nla_data(info->attrs[GENL_HB_ATTR_MSG]), length);
 
         printk(KERN_NOTICE "Going to display the pattern.\n");
         // [ToDo] Check chip_select initialized.
-        max7219_send_msg(pattern.led, sizeof(genl_hb_pattern_t), s_pins.chip_select);
+        return max7219_send_msg((uint8_t *)pattern, length, s_pins.chip_select);
+}
 
-        return 0;
+static int genl_hb_rx_sequence_msg(struct sk_buff* skb, struct genl_info* info) {
+        genl_hb_sequence_t *seq;
+        int ret;
+
+        if (!info->attrs[GENL_HB_ATTR_SEQ]) {
+                printk(KERN_ERR "empty sequence from %d!!\n", info->snd_portid);
+                return -EINVAL;
+        }
+
+        // Frames left out are never played.
+        seq = kzalloc(sizeof(genl_hb_sequence_t), GFP_KERNEL);
+        if (!seq)
+                return -ENOMEM;
+        memcpy(seq, nla_data(info->attrs[GENL_HB_ATTR_SEQ]),
+               min_t(int, nla_len(info->attrs[GENL_HB_ATTR_SEQ]), sizeof(genl_hb_sequence_t)));
+
+        printk(KERN_NOTICE "Going to play %u frames, %u loops.\n", seq->count, seq->loops);
+        ret = sequencer_load(seq, s_pins.chip_select);
+        kfree(seq);
+        return ret;
+}
+
+static int genl_hb_rx_rate_msg(struct sk_buff* skb, struct genl_info* info) {
+        // Length checked by the policy.
+        if (!info->attrs[GENL_HB_ATTR_RATE]) {
+                printk(KERN_ERR "empty rate from %d!!\n", info->snd_portid);
+                return -EINVAL;
+        }
+
+        return sequencer_set_rate(nla_get_u32(info->attrs[GENL_HB_ATTR_RATE]));
 }
 
 static void genl_hb_tx_distance_msg(unsigned long data) {   
@@ -256,6 +327,9 @@ static int __init heartbeat_init(void) {
         if (ret)
                 return -EINVAL;
 
+        // Nothing to play until a sequence is uploaded.
+        sequencer_init();
+
         // Initialize HCSR-04 Ultrasonic Driver.
         ret = hcsr_init_one(&hcsr04_sensor);
         if (ret)
@@ -273,6 +347,9 @@ static void heartbeat_exit(void) {
         // Unregister Netlink family.
         genl_unregister_family(&genl_hb_family);
 
+        // Stop the animation before its display goes away.
+        sequencer_exit();
+
         // Remove MAX7219 Driver.
         max7219_device_exit();
 
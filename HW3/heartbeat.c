@@ -4,7 +4,11 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
 #include <unistd.h>
+#include <poll.h>
 
 #include <errno.h>
 
@@ -23,48 +27,60 @@
 #endif
 
 #define MS_SCALE    (1000)          /**< 1 Milli-seconds */
-
-static pthread_t dis_measure;       /**< A thread to measure the distance */
+#define NS_SCALE    (1000000000ULL) /**< 1 Second */
+
+#define HB_BATCH    (4)             /**< Most commands pipelined in one sendmsg */
+#define HB_INFLIGHT (64)            /**< Most commands waiting for their ack */
+#define HB_REPORT   (50)            /**< Ticks between two latency reports */
+#define HB_TIMEOUT  (1000)          /**< Milli-seconds before a lost measurement is asked again */
+
+/** Round trip statistics of one command */
+typedef struct hb_latency {
+    unsigned long count;            /**< Acks received */
+    unsigned long errors;           /**< Acks carrying an error */
+    uint64_t total_ns;              /**< Sum of the round trips */
+    uint64_t max_ns;                /**< Longest round trip */
+} hb_latency_t;
+
+/** A command sent, waiting for its ack */
+typedef struct hb_inflight {
+    uint32_t seq;                   /**< Netlink sequence number */
+    int type;                       /**< Command */
+    uint64_t sent_ns;               /**< Time sent, 0 when the slot is free */
+} hb_inflight_t;
+
+/** One netlink session, shared by the display loop and the receiver */
+typedef struct hb_session {
+    struct nl_sock *sock;                   /**< The only socket */
+    pthread_mutex_t sock_lock;              /**< Serializes sock between sender and receiver */
+    struct nl_cb *cb;                       /**< Receiver callbacks */
+    int family_id;                          /**< Resolved once */
+    struct nl_msg *msgs[HB_BATCH];          /**< Preallocated, reused every batch */
+    int queued;                             /**< Commands in msgs, not sent yet */
+    pthread_mutex_t lock;                   /**< Guards inflight and latency */
+    hb_inflight_t inflight[HB_INFLIGHT];
+    hb_latency_t latency[GENL_HB_RATE_MSG + 1];
+} hb_session_t;
+
+static const char *cmd_names[GENL_HB_RATE_MSG + 1] = {
+    [GENL_HB_CONFIG_MSG] = "config",
+    [GENL_HB_MEASURE_MSG] = "measure",
+    [GENL_HB_DISPLAY_MSG] = "display",
+    [GENL_HB_SEQUENCE_MSG] = "sequence",
+    [GENL_HB_RATE_MSG] = "rate",
+};
+
+static pthread_t dis_measure;       /**< A thread to receive the distance */
 
 volatile atomic_int distance = 100; /**< atomic variable for IPC */
+volatile atomic_int measuring = 0;  /**< A measurement is on its way */
+static volatile sig_atomic_t running = 1;
 
-static int send_msg_to_kernel(struct nl_sock *sock, char *message, int type, int length) {
-    struct nl_msg* msg;
-    int family_id, err = 0;
+static uint64_t now_ns(void) {
+    struct timespec ts;
 
-    family_id = genl_ctrl_resolve(sock, GENL_HB_FAMILY_NAME);
-    if(family_id < 0){
-        fprintf(stderr, "Unable to resolve family name!\n");
-        exit(EXIT_FAILURE);
-    }
-
-    msg = nlmsg_alloc();
-    if (!msg) {
-        fprintf(stderr, "failed to allocate netlink message\n");
-        exit(EXIT_FAILURE);
-    }
-
-    if(!genlmsg_put(msg, NL_AUTO_PID, NL_AUTO_SEQ, family_id, 0, 
-        NLM_F_REQUEST, type, 0)) {
-        fprintf(stderr, "failed to put nl hdr!\n");
-        err = -ENOMEM;
-        goto out;
-    }
-
-    err = nla_put(msg, GENL_HB_ATTR_MSG, length, message);
-    if (err) {
-        fprintf(stderr, "failed to put nl string!\n");
-        goto out;
-    }
-
-    err = nl_send_auto(sock, msg);
-    if (err < 0) {
-        fprintf(stderr, "failed to send nl message!\n");
-    }
-
-out:
-    nlmsg_free(msg);
-    return err;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * NS_SCALE + ts.tv_nsec;
 }
 
 static int skip_seq_check(struct nl_msg *msg, void *arg) {
@@ -86,85 +102,289 @@ static int on_distance(struct nl_msg *msg, void* arg) {
         nla_get_u64(attr[GENL_HB_ATTR_DIS]));
 
     distance = nla_get_u64(attr[GENL_HB_ATTR_DIS]);
+    measuring = 0;
 
     return NL_OK;
 }
 
-static void prep_nl_sock(struct nl_sock** nlsock) {
-    int family_id;
-    
-    *nlsock = nl_socket_alloc();
-    if(!*nlsock) {
+/**
+ * @brief account the round trip of an acked command.
+ * @param s, the session.
+ * @param seq, sequence number of the command.
+ * @param error, error carried by the ack, 0 on success.
+ */
+static void session_complete(hb_session_t *s, uint32_t seq, int error) {
+    hb_inflight_t *f = &s->inflight[seq % HB_INFLIGHT];
+    hb_latency_t *l;
+    uint64_t rtt;
+
+    pthread_mutex_lock(&s->lock);
+    if (!f->sent_ns || f->seq != seq) {
+        pthread_mutex_unlock(&s->lock);
+        return;
+    }
+
+    rtt = now_ns() - f->sent_ns;
+    l = &s->latency[f->type];
+    l->count++;
+    l->total_ns += rtt;
+    if (rtt > l->max_ns)
+        l->max_ns = rtt;
+    if (error) {
+        l->errors++;
+        // No distance follows a refused measurement.
+        if (f->type == GENL_HB_MEASURE_MSG)
+            measuring = 0;
+    }
+    f->sent_ns = 0;
+    pthread_mutex_unlock(&s->lock);
+}
+
+static int on_ack(struct nl_msg *msg, void *arg) {
+    session_complete(arg, nlmsg_hdr(msg)->nlmsg_seq, 0);
+    return NL_OK;
+}
+
+static int on_error(struct sockaddr_nl *nla, struct nlmsgerr *err, void *arg) {
+    session_complete(arg, err->msg.nlmsg_seq, err->error);
+    return NL_SKIP;
+}
+
+/**
+ * @brief connect the session, resolve the family and preallocate messages.
+ * @param s, the session.
+ */
+static void session_open(hb_session_t *s) {
+    int i;
+
+    memset(s, 0, sizeof(hb_session_t));
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_mutex_init(&s->sock_lock, NULL);
+
+    s->sock = nl_socket_alloc();
+    if (!s->sock) {
         fprintf(stderr, "Unable to alloc nl socket!\n");
         exit(EXIT_FAILURE);
     }
 
-    /* disable seq checks on multicast sockets */
-    nl_socket_disable_seq_check(*nlsock);
-    nl_socket_disable_auto_ack(*nlsock);
+    /* the kernel replies the distance with sequence 0, acks are matched by hand */
+    nl_socket_disable_seq_check(s->sock);
+    nl_socket_disable_auto_ack(s->sock);
 
     /* connect to genl */
-    if (genl_connect(*nlsock)) {
+    if (genl_connect(s->sock)) {
         fprintf(stderr, "Unable to connect to genl!\n");
         goto exit_err;
     }
 
-    /* resolve the generic nl family id*/
-    family_id = genl_ctrl_resolve(*nlsock, GENL_HB_FAMILY_NAME);
-    if(family_id < 0){
+    /* resolve the generic nl family id, once for the whole session */
+    s->family_id = genl_ctrl_resolve(s->sock, GENL_HB_FAMILY_NAME);
+    if (s->family_id < 0) {
         fprintf(stderr, "Unable to resolve family name!\n");
         goto exit_err;
     }
 
+    /* the receiver polls without the lock, then only drains what is queued */
+    if (nl_socket_set_nonblocking(s->sock)) {
+        fprintf(stderr, "Unable to set nl socket nonblocking!\n");
+        goto exit_err;
+    }
+
+    for (i = 0; i < HB_BATCH; ++i) {
+        s->msgs[i] = nlmsg_alloc();
+        if (!s->msgs[i]) {
+            fprintf(stderr, "failed to allocate netlink message\n");
+            goto exit_err;
+        }
+    }
+
+    /* preparing for the respond callback */
+    s->cb = nl_cb_alloc(NL_CB_DEFAULT);
+    if (!s->cb) {
+        fprintf(stderr, "failed to allocate netlink callbacks\n");
+        goto exit_err;
+    }
+    nl_cb_set(s->cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, skip_seq_check, NULL);
+    nl_cb_set(s->cb, NL_CB_VALID, NL_CB_CUSTOM, on_distance, NULL);
+    nl_cb_set(s->cb, NL_CB_ACK, NL_CB_CUSTOM, on_ack, s);
+    nl_cb_err(s->cb, NL_CB_CUSTOM, on_error, s);
+
     return;
 
 exit_err:
-    nl_socket_free(*nlsock); // this call closes the socket as well
+    for (i = 0; i < HB_BATCH; ++i)
+        if (s->msgs[i])
+            nlmsg_free(s->msgs[i]);
+    nl_socket_free(s->sock); // this call closes the socket as well
     exit(EXIT_FAILURE);
 }
 
+static void session_close(hb_session_t *s) {
+    int i;
+
+    nl_cb_put(s->cb);
+    for (i = 0; i < HB_BATCH; ++i)
+        nlmsg_free(s->msgs[i]);
+    nl_socket_free(s->sock);
+    pthread_mutex_destroy(&s->sock_lock);
+    pthread_mutex_destroy(&s->lock);
+}
+
+/**
+ * @brief send every queued command in one sendmsg.
+ * @param s, the session.
+ * @return bytes sent, otherwise negative libnl error.
+ */
+static int session_flush(hb_session_t *s) {
+    struct iovec iov[HB_BATCH];
+    struct nlmsghdr *hdr;
+    uint64_t now;
+    int i, err;
+
+    if (!s->queued)
+        return 0;
+
+    now = now_ns();
+    pthread_mutex_lock(&s->sock_lock);
+    pthread_mutex_lock(&s->lock);
+    for (i = 0; i < s->queued; ++i) {
+        // Fills in the port and the sequence number.
+        nl_complete_msg(s->sock, s->msgs[i]);
+        hdr = nlmsg_hdr(s->msgs[i]);
+        iov[i].iov_base = hdr;
+        iov[i].iov_len = hdr->nlmsg_len;
+
+        s->inflight[hdr->nlmsg_seq % HB_INFLIGHT].seq = hdr->nlmsg_seq;
+        s->inflight[hdr->nlmsg_seq % HB_INFLIGHT].type = genlmsg_hdr(hdr)->cmd;
+        s->inflight[hdr->nlmsg_seq % HB_INFLIGHT].sent_ns = now;
+    }
+    pthread_mutex_unlock(&s->lock);
+
+    err = nl_send_iovec(s->sock, s->msgs[0], iov, s->queued);
+    pthread_mutex_unlock(&s->sock_lock);
+    if (err < 0) {
+        fprintf(stderr, "failed to send nl message!\n");
+    }
+
+    s->queued = 0;
+    return err;
+}
+
+/**
+ * @brief build a command in the next free message, sent by session_flush.
+ * @param s, the session.
+ * @param attr, attribute carrying the message.
+ * @param message, payload.
+ * @param type, command.
+ * @param length, payload length.
+ * @return 0 on success, otherwise negative error.
+ */
+static int session_queue(hb_session_t *s, int attr, void *message, int type, int length) {
+    struct nl_msg *msg;
+    int err;
+
+    if (s->queued == HB_BATCH)
+        session_flush(s);
+
+    // Reuse the buffer, the new header goes right after the nl header.
+    msg = s->msgs[s->queued];
+    nlmsg_hdr(msg)->nlmsg_len = NLMSG_HDRLEN;
+
+    if(!genlmsg_put(msg, NL_AUTO_PORT, NL_AUTO_SEQ, s->family_id, 0, 
+        NLM_F_REQUEST | NLM_F_ACK, type, 0)) {
+        fprintf(stderr, "failed to put nl hdr!\n");
+        return -ENOMEM;
+    }
+
+    err = nla_put(msg, attr, length, message);
+    if (err) {
+        fprintf(stderr, "failed to put nl string!\n");
+        return err;
+    }
+
+    s->queued++;
+    return 0;
+}
+
+/**
+ * @brief print the round trip of every command acked so far.
+ * @param s, the session.
+ */
+static void session_report(hb_session_t *s) {
+    hb_latency_t *l;
+    int i;
+
+    pthread_mutex_lock(&s->lock);
+    for (i = 0; i <= GENL_HB_RATE_MSG; ++i) {
+        l = &s->latency[i];
+        if (!l->count)
+            continue;
+        printf("%-8s acks:%lu errors:%lu avg:%lluus max:%lluus\n", cmd_names[i],
+            l->count, l->errors,
+            (unsigned long long)(l->total_ns / l->count / 1000),
+            (unsigned long long)(l->max_ns / 1000));
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
 void *dis_thread(void *vargp) {
-    struct nl_sock* nlsock = NULL;
-    struct nl_cb *cb = NULL;
-    int ret;
-    char message[GENL_HB_ATTR_MSG_MAX];
+    hb_session_t *s = vargp;
+    struct pollfd pfd;
+    int ret = 0, state;
 
-    prep_nl_sock(&nlsock);
+    pfd.fd = nl_socket_get_fd(s->sock);
+    pfd.events = POLLIN;
 
-    /* preparing for the respond callback */
-    cb = nl_cb_alloc(NL_CB_DEFAULT);
-    nl_cb_set(cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, skip_seq_check, NULL);
-    nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, on_distance, NULL);
+    // Distance replies and acks of every command, until cancelled. Wait
+    // outside the lock so the display loop keeps sending meanwhile.
     do {
-        send_msg_to_kernel(nlsock, message, GENL_HB_MEASURE_MSG, 8);
-        ret = nl_recvmsgs(nlsock, cb);
-        usleep(100 * MS_SCALE);
-    } while (!ret);
+        if (poll(&pfd, 1, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
 
-    nl_cb_put(cb);
-    nl_socket_free(nlsock);
+        // Never cancelled while holding the socket.
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+        pthread_mutex_lock(&s->sock_lock);
+        ret = nl_recvmsgs(s->sock, s->cb);
+        pthread_mutex_unlock(&s->sock_lock);
+        pthread_setcancelstate(state, NULL);
+    } while (ret >= 0);
 
+    fprintf(stderr, "failed to receive nl message!\n");
     return NULL;
 }
 
+static void on_signal(int sig) {
+    running = 0;
+}
+
 int main(int argc, char *argv[]) {
-    struct nl_sock* nlsock = NULL;
+    hb_session_t session;
     char message[GENL_HB_ATTR_MSG_MAX];
+    genl_hb_sequence_t seq;
     int sleep_time = 100;
+    uint32_t rate = 0, last_rate = 0;
     uint8_t big_heart[8] = {0x1c, 0x3e, 0x7f, 0xfe, 0xfe, 0x7f, 0x3e, 0x1c};
     uint8_t small_heart[8] = {0x00, 0x1c, 0x3e, 0x7c, 0x7c, 0x3e, 0x1c, 0x00};
     genl_hb_pins_t ps;
+    uint64_t measure_sent = 0;
+    int i, tick = 0;
 
     if (argc < 4) {
-        printf("Usage: ./heart chip_select trigger echo\n");
+        printf("Usage: ./heart chip_select trigger echo [chain]\n");
         return -EINVAL;
     }
 
-    prep_nl_sock(&nlsock);
-
     ps.chip_select = atoi(argv[1]);
     ps.trigger = atoi(argv[2]);
     ps.echo = atoi(argv[3]);
+    ps.chain = argc > 4 ? atoi(argv[4]) : 1;
+    if (ps.chain < 1 || ps.chain > GENL_HB_MAX_CHAIN) {
+        printf("Chain of 1 to %d matrices\n", GENL_HB_MAX_CHAIN);
+        return -EINVAL;
+    }
 
     memcpy(message, &ps, sizeof(genl_hb_pins_t));
     message[sizeof(genl_hb_pins_t)] = '\0';
@@ -172,33 +392,62 @@ int main(int argc, char *argv[]) {
     printf("Trigger:%d, Echo:%d\n", ps.trigger, ps.echo);
     printf("CS:%d, Trigger:%d, Echo:%d\n", MAX7219_CS_PIN, HCSR04_TRIGGER_PIN, HCSR04_ECHO_PIN);
 
-    send_msg_to_kernel(nlsock, message, GENL_HB_CONFIG_MSG, sizeof(genl_hb_pins_t));
+    session_open(&session);
+    signal(SIGINT, on_signal);
+
+    pthread_create(&dis_measure, NULL, dis_thread, &session);
+
+    session_queue(&session, GENL_HB_ATTR_MSG, message, GENL_HB_CONFIG_MSG, sizeof(genl_hb_pins_t));
+
+    // The kernel beats the heart, big then small, on every matrix of the chain.
+    memset(&seq, 0, sizeof(genl_hb_sequence_t));
+    seq.count = 2;
+    seq.loops = 0;
+    seq.frames[0].duration = MS_SCALE;
+    seq.frames[1].duration = MS_SCALE;
+    for (i = 0; i < ps.chain; ++i) {
+        memcpy(seq.frames[0].pattern[i].led, big_heart, 8 * sizeof(uint8_t));
+        memcpy(seq.frames[1].pattern[i].led, small_heart, 8 * sizeof(uint8_t));
+    }
+    session_queue(&session, GENL_HB_ATTR_SEQ, &seq, GENL_HB_SEQUENCE_MSG, sizeof(genl_hb_sequence_t));
+    session_flush(&session);
+
+    while (running) {
+        sleep_time = distance * 10;
+        if (sleep_time < 500) {
+            sleep_time = 500;
+        } else if (sleep_time > 2000) {
+            sleep_time = 2000;
+        }
 
-    pthread_create(&dis_measure, NULL, dis_thread, NULL);
+        // Only the rate changes with the distance, the frames stay in the kernel.
+        rate = GENL_HB_RATE_NORMAL * MS_SCALE / sleep_time;
+        if (rate != last_rate) {
+            printf("Updated sleep time:%d\n", sleep_time);
+            session_queue(&session, GENL_HB_ATTR_RATE, &rate, GENL_HB_RATE_MSG, sizeof(uint32_t));
+            last_rate = rate;
+        }
 
-    while (1) {
-        sleep_time = distance * 10 * MS_SCALE;
-        if (sleep_time < 500 * MS_SCALE) {
-            sleep_time = 500 * MS_SCALE;
-        } else if (sleep_time > 2000 * MS_SCALE) {
-            sleep_time = 2000 * MS_SCALE;
+        // One measurement at a time, sent along with the rate. The kernel
+        // may fail to send the distance back, don't wait for it forever.
+        if (!measuring || now_ns() - measure_sent > HB_TIMEOUT * NS_SCALE / MS_SCALE) {
+            measuring = 1;
+            measure_sent = now_ns();
+            session_queue(&session, GENL_HB_ATTR_MSG, message, GENL_HB_MEASURE_MSG, 8);
         }
-        printf("Updated sleep time:%d\n", sleep_time);
+        session_flush(&session);
 
-        memcpy(message, big_heart, 8 * sizeof(uint8_t));
-        send_msg_to_kernel(nlsock, message, GENL_HB_DISPLAY_MSG, sizeof(genl_hb_pattern_t));
-    
-        usleep(sleep_time);
-    
-        memcpy(message, small_heart, 8 * sizeof(uint8_t));
-        send_msg_to_kernel(nlsock, message, GENL_HB_DISPLAY_MSG, sizeof(genl_hb_pattern_t));
+        if (++tick % HB_REPORT == 0)
+            session_report(&session);
 
-        usleep(sleep_time);
+        usleep(100 * MS_SCALE);
     }
 
-    nl_socket_free(nlsock);
-
+    pthread_cancel(dis_measure);
     pthread_join(dis_measure, NULL);
 
+    session_report(&session);
+    session_close(&session);
+
     return 0;
 }
@@ -7,11 +7,13 @@
 #include <linux/spi/spi.h>
 #include <linux/gpio.h>
 
-#include <linux/delay.h>
-
+#include <linux/slab.h>
+#include <linux/mutex.h>
+#include <linux/spinlock.h>
 #include <linux/workqueue.h>
 
 #include "gpio_config.h"
+#include "max7219.h"
 
 #define SPI_DIR         (24)                    /**< SPI Direction GPIO pin */
 #define SPI_MUX1        (44)                    /**< SPI MUX1 GPIO pin */
@@ -21,6 +23,9 @@
 #define SCK_MUX1        (46)                    /**< SCK MUX1 GPIO pin */
 
 #define NUM_OF_COLUMNS  (8)                     /**< Number of the columns in LED Matrix */
+#define NUM_OF_INIT     (4)                     /**< Registers written by the init sequence */
+#define SPI_SPEED       (1000000)               /**< SPI clock in Hz */
+#define FULL_REFRESH    (32)                    /**< Frames between full refreshes */
 
 /** @reference https://datasheets.maximintegrated.com/en/ds/MAX7219-MAX7221.pdf 
  *  This document explained the details about how MAX7219 register works.
@@ -38,15 +43,63 @@ static uint8_t s_init_sequence[][2] = {
         {0xff, 0xff},
 };
 
-// [ToDo] for more than one device.
+// One SPI device, a chain of up to MAX_CHAIN MAX7219s behind its chip select.
 static struct spi_device *max7219_device = NULL;        /**< SPI device structure */
-static struct workqueue_struct *max7219_wq = NULL;      /**< Work queue for one device */
+static struct workqueue_struct *max7219_wq = NULL;      /**< Renders frames, may sleep on the bus */
+
+struct spi_ioc_transfer {
+        __u64           tx_buf;
+
+        __u32           len;
+        __u32           speed_hz;
+
+        __u16           delay_usecs;
+        __u8            bits_per_word;
+        __u8            cs_change;
+        __u8            tx_nbits;
+};
+
+/**
+ * One frame, one transfer per column, each latched by its own CS pulse.
+ * A column goes to every chip of the chain in one transfer, the farthest
+ * chip first, since each chip shifts out what it held before.
+ */
+typedef struct {
+        struct spi_ioc_transfer tr[NUM_OF_COLUMNS]; /**< Columns to send, 2 * chain bytes each */
+        uint8_t tx[NUM_OF_COLUMNS][2 * MAX_CHAIN]; /**< Column register and data per chip */
+} display_frame_t;
 
+/**
+ * Latest-wins mailbox, writers overwrite the pending frame, one work item renders.
+ * Frames are chain * NUM_OF_COLUMNS bytes, chip k of the chain (0 nearest)
+ * shows bytes k * NUM_OF_COLUMNS to k * NUM_OF_COLUMNS + 7.
+ */
 typedef struct {
-        struct work_struct display_work;
-        int cs_pin;
-        uint8_t led[NUM_OF_COLUMNS];
-} display_work_t;
+        spinlock_t lock;                        /**< Guards pending, dirty, stale and chain */
+        uint8_t pending[MAX_CHAIN * NUM_OF_COLUMNS]; /**< Newest frame from the writers */
+        int dirty;                              /**< Pending frame not rendered yet */
+        int stale;                              /**< Panel reset, shown is not trusted */
+        unsigned int chain;                     /**< MAX7219s in the chain */
+        display_frame_t frame;                  /**< Frame being rendered */
+        uint8_t shown[NUM_OF_COLUMNS][2 * MAX_CHAIN]; /**< Columns the panel shows, work item only */
+        unsigned int since_full;                /**< Frames since the last full refresh */
+        struct work_struct work;                /**< Renders the newest frame */
+        unsigned long submitted;                /**< Frames from the writers */
+        unsigned long rendered;                 /**< Frames sent to the panel */
+        unsigned long coalesced;                /**< Frames overwritten before rendered */
+        unsigned long rows;                     /**< Rows sent to the panel */
+} display_mailbox_t;
+
+static display_mailbox_t s_mailbox;             /**< Mailbox of the display */
+
+module_param_named(frames_submitted, s_mailbox.submitted, ulong, S_IRUGO);
+module_param_named(frames_rendered, s_mailbox.rendered, ulong, S_IRUGO);
+module_param_named(frames_coalesced, s_mailbox.coalesced, ulong, S_IRUGO);
+module_param_named(rows_sent, s_mailbox.rows, ulong, S_IRUGO);
+
+static unsigned int full_refresh = FULL_REFRESH;
+module_param(full_refresh, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(full_refresh, "Frames between full refreshes, 0 only changed rows");
 
 static struct spi_board_info max7219_info = {
         .modalias = "max7219-led",
@@ -57,7 +110,15 @@ static struct spi_board_info max7219_info = {
         .mode = SPI_MODE_0,
 };
 
-#define BUFF_SIZE       (4096)                  /**< Buffer size */
+#define XFER_BYTES      (NUM_OF_COLUMNS * 2 * MAX_CHAIN) /**< Payload of one request */
+
+/** Preallocated SPI request, the payload is bounced into its DMA-safe buffer */
+struct spidev_request {
+        struct spi_message      msg;
+        struct spi_transfer     xfers[NUM_OF_COLUMNS];
+        /* Own cache lines, nothing else is touched while the controller maps it */
+        u8                      tx_buf[XFER_BYTES] ____cacheline_aligned;
+};
 
 /** per device structure */
 struct max7219_dev {
@@ -65,21 +126,12 @@ struct max7219_dev {
         struct spi_device       *spi;
         u8                      cs;
 
-        /* TX/RX buffers are NULL unless this device is open (users > 0) */
-        u8                      *tx_buffer;
-        u32                     speed_hz;
-};
+        struct mutex            latch_lock;     /* One CS pulse on the bus at a time */
+        int                     cs_gpio;        /* Chip select, -1 until configured */
 
-struct spi_ioc_transfer {
-        __u32           tx_buf;
-
-        __u32           len;
-        __u32           speed_hz;
-
-        __u16           delay_usecs;
-        __u8            bits_per_word;
-        __u8            cs_change;
-        __u8            tx_nbits;
+        /* Only used between two CS edges, so latch_lock guards it as well */
+        struct spidev_request   *request;
+        u32                     speed_hz;
 };
 
 static atomic_t available = ATOMIC_INIT(1);     /**< Singleton lock */
@@ -124,42 +176,44 @@ spidev_sync(struct max7219_dev *spidev, struct spi_message *message)
 static int spidev_message(struct max7219_dev *spidev,
                 struct spi_ioc_transfer *u_xfers, unsigned n_xfers)
 {
-        struct spi_message      msg;
-        struct spi_transfer     *k_xfers;
+        struct spidev_request   *req = spidev->request;
         struct spi_transfer     *k_tmp;
         struct spi_ioc_transfer *u_tmp;
         unsigned                n, total;
         u8                      *tx_buf;
-        int                     status = -EFAULT;
+        int                     status;
 
-        spi_message_init(&msg);
-        k_xfers = kcalloc(n_xfers, sizeof(*k_tmp), GFP_KERNEL);
-        if (k_xfers == NULL)
-                return -ENOMEM;
+        // Nothing is allocated here, every caller latches its transfers.
+        lockdep_assert_held(&spidev->latch_lock);
+
+        if (n_xfers > NUM_OF_COLUMNS)
+                return -EMSGSIZE;
 
-        /* Construct spi_message, copying any tx data to bounce buffer.
-         * We walk the array of user-provided transfers, using each one
+        /* Construct spi_message, copying any tx data to the request buffer.
+         * We walk the array of caller-provided transfers, using each one
          * to initialize a kernel version of the same transfer.
          */
-        tx_buf = spidev->tx_buffer;
+        spi_message_init(&req->msg);
+        tx_buf = req->tx_buf;
         total = 0;
-        for (n = n_xfers, k_tmp = k_xfers, u_tmp = u_xfers;
+        for (n = n_xfers, k_tmp = req->xfers, u_tmp = u_xfers;
                         n;
                         n--, k_tmp++, u_tmp++) {
+                memset(k_tmp, 0, sizeof(*k_tmp));
                 k_tmp->len = u_tmp->len;
 
                 total += k_tmp->len;
                 /* Check total length of transfers.  Also check each
                  * transfer length to avoid arithmetic overflow.
                  */
-                if (total > BUFF_SIZE || k_tmp->len > BUFF_SIZE) {
-                        status = -EMSGSIZE;
-                        goto done;
-                }
+                if (total > XFER_BYTES || k_tmp->len > XFER_BYTES)
+                        return -EMSGSIZE;
 
                 if (u_tmp->tx_buf) {
                         k_tmp->tx_buf = tx_buf;
-                        strncpy(tx_buf, (void *)u_tmp->tx_buf, u_tmp->len);
+                        // Payload is binary, zero bytes included.
+                        memcpy(tx_buf, (const void *)(unsigned long)u_tmp->tx_buf,
+                               u_tmp->len);
                 }
 
                 tx_buf += k_tmp->len;
@@ -172,18 +226,38 @@ static int spidev_message(struct max7219_dev *spidev,
                 if (!k_tmp->speed_hz)
                         k_tmp->speed_hz = spidev->speed_hz;
 
-                spi_message_add_tail(k_tmp, &msg);
+                spi_message_add_tail(k_tmp, &req->msg);
         }
 
-        status = spidev_sync(spidev, &msg);
+        status = spidev_sync(spidev, &req->msg);
         if (status < 0)
-                goto done;
+                return status;
 
-        status = total;
+        return total;
+}
 
-done:
-        kfree(k_xfers);
-        return status;
+/**
+ * @brief preallocate the request.
+ * @param spidev, the device.
+ * @return 0 on success, otherwise failed.
+ */
+static int spidev_request_init(struct max7219_dev *spidev)
+{
+        // kmalloc memory is DMA-safe, unlike the module's own data.
+        spidev->request = kzalloc(sizeof(struct spidev_request), GFP_KERNEL);
+        if (spidev->request == NULL)
+                return -ENOMEM;
+        return 0;
+}
+
+/**
+ * @brief release the request, nobody may be sending.
+ * @param spidev, the device.
+ */
+static void spidev_request_fini(struct max7219_dev *spidev)
+{
+        kfree(spidev->request);
+        spidev->request = NULL;
 }
 
 /* ============================================================================*/
@@ -200,14 +274,35 @@ static int max7219_setup(void);
 static void max7219_teardown(void);
 
 /**
- * @brief send out one MAX7219 format message on SPI bus.
- * @param address, D15-D8 stands for the register address.
- * @param data, D7-D0 stands for the register data.
+ * @brief send transfers one by one, each latched by a pulse on the chip select.
+ * @param tr, the transfers.
+ * @param n, the number of transfers.
+ * @return 0 on success, otherwise failed.
+ * @note the chip select is an expander GPIO the controller can't drive,
+ * and it may sleep, so it is pulsed here in process context.
+ */
+static int max7219_send_latched(struct spi_ioc_transfer *, unsigned int);
+
+/**
+ * @brief send out MAX7219 format messages on SPI bus, one transfer each.
+ * @param regs, D15-D8 the register address, D7-D0 the register data.
+ * @param n, the number of registers.
+ * @param chain, every register goes to this many chips.
+ * @return 0 on success, otherwise failed.
  */
-static void max7219_send_one_msg(uint8_t, uint8_t);
+static int max7219_send_regs(uint8_t (*)[2], unsigned int, unsigned int);
 
 /**
- * @brief a work queue function to send the data.
+ * @brief list the columns to send in the transfers of a frame.
+ * @param frame, the frame.
+ * @param mask, bit i set to send column i.
+ * @param chain, the chips in the chain.
+ * @return the number of transfers listed.
+ */
+static unsigned int max7219_frame_link(display_frame_t *, unsigned int, unsigned int);
+
+/**
+ * @brief a work queue function rendering the newest frame in the mailbox.
  * @param work, the work structure.
  */
 static void max7219_work_function(struct work_struct *);
@@ -234,62 +329,161 @@ static void max7219_teardown(void) {
         gpio_free(SCK_MUX1);
 }
 
-static void max7219_send_one_msg(uint8_t address, uint8_t data) {
-        uint8_t tx[2];
-        struct spi_ioc_transfer tr = {
-            .delay_usecs = 0,
-            .speed_hz = 1000000,
-            .bits_per_word = 8,
-            //.cs_change = true,
-        };
+static int max7219_send_latched(struct spi_ioc_transfer *tr, unsigned int n) {
+        unsigned int i;
+        int ret = 0;
 
-        tr.tx_buf = (unsigned long)tx;
-        tr.len = 2;
+        mutex_lock(&spidev.latch_lock);
+        if (spidev.cs_gpio < 0) {
+                mutex_unlock(&spidev.latch_lock);
+                return -ENODEV;
+        }
 
-        tx[0] = address;
-        tx[1] = data;
+        for (i = 0; i < n; ++i) {
+                gpio_set_value_cansleep(spidev.cs_gpio, 0);
+                ret = spidev_message(&spidev, &tr[i], 1);
+                // The rising edge latches the register.
+                gpio_set_value_cansleep(spidev.cs_gpio, 1);
+                if (ret < 0)
+                        break;
+        }
+        mutex_unlock(&spidev.latch_lock);
 
-        spidev_message(&spidev, &tr, 1);
+        return ret < 0 ? ret : 0;
 }
 
-static void max7219_work_function(struct work_struct *work) {
-        // We are not using contianer_of here, since the struct layout.
-        display_work_t *my_work = (display_work_t *)work;
-        uint8_t i;
-        int cs_gpio;
+static int max7219_send_regs(uint8_t (*regs)[2], unsigned int n, unsigned int chain) {
+        struct spi_ioc_transfer tr[NUM_OF_COLUMNS];
+        uint8_t tx[NUM_OF_COLUMNS][2 * MAX_CHAIN];
+        unsigned int i;
+        unsigned int k;
+
+        memset(tr, 0, sizeof(tr));
+        for (i = 0; i < n; ++i) {
+                // Same register to every chip of the chain.
+                for (k = 0; k < chain; ++k) {
+                        tx[i][2 * k] = regs[i][0];
+                        tx[i][2 * k + 1] = regs[i][1];
+                }
+                tr[i].tx_buf = (unsigned long)tx[i];
+                tr[i].len = 2 * chain;
+                tr[i].speed_hz = SPI_SPEED;
+                tr[i].bits_per_word = 8;
+        }
 
-        cs_gpio = quark_gpio_shield_to_gpio(my_work->cs_pin);
+        return max7219_send_latched(tr, n);
+}
 
+static unsigned int max7219_frame_link(display_frame_t *frame, unsigned int mask,
+                                       unsigned int chain) {
+        struct spi_ioc_transfer *tr = frame->tr;
+        unsigned int n = 0;
+        uint8_t i;
+
+        memset(tr, 0, sizeof(frame->tr));
         for (i = 0; i < NUM_OF_COLUMNS; i++) {
-                gpio_set_value_cansleep(cs_gpio, 0);
-                barrier();
-                max7219_send_one_msg(i + 1, my_work->led[i]);
-                barrier();
-                gpio_set_value_cansleep(cs_gpio, 1);
-                mdelay(10);
+                if (!(mask & (1 << i)))
+                        continue;
+                tr[n].tx_buf = (unsigned long)frame->tx[i];
+                tr[n].len = 2 * chain;
+                tr[n].speed_hz = SPI_SPEED;
+                tr[n].bits_per_word = 8;
+                n++;
         }
+        return n;
+}
+
+static void max7219_work_function(struct work_struct *work) {
+        display_mailbox_t *mb = container_of(work, display_mailbox_t, work);
+        unsigned int refresh = ACCESS_ONCE(full_refresh);
+        unsigned int chain;
+        unsigned int mask;
+        unsigned int n;
+        unsigned int k;
+        uint8_t i;
+        int ret;
 
-        kfree(work);
+        // Frames written while we render are picked up by the next turn.
+        while (1) {
+                spin_lock_irq(&mb->lock);
+                if (!mb->dirty) {
+                        spin_unlock_irq(&mb->lock);
+                        break;
+                }
+                chain = mb->chain;
+                // The farthest chip is shifted out first.
+                for (i = 0; i < NUM_OF_COLUMNS; i++) {
+                        for (k = 0; k < chain; k++) {
+                                mb->frame.tx[i][2 * k] = i + 1;
+                                mb->frame.tx[i][2 * k + 1] =
+                                        mb->pending[(chain - 1 - k) * NUM_OF_COLUMNS + i];
+                        }
+                }
+                mb->dirty = 0;
+                // Rewrite everything now and then, in case the panel glitched.
+                if (mb->stale || (refresh && mb->since_full >= refresh)) {
+                        mb->stale = 0;
+                        mb->since_full = 0;
+                        mask = (1 << NUM_OF_COLUMNS) - 1;
+                } else {
+                        mb->since_full++;
+                        mask = 0;
+                        for (i = 0; i < NUM_OF_COLUMNS; i++)
+                                if (memcmp(mb->frame.tx[i], mb->shown[i], 2 * chain))
+                                        mask |= 1 << i;
+                }
+                spin_unlock_irq(&mb->lock);
+
+                // Same as shown, nothing to send.
+                n = max7219_frame_link(&mb->frame, mask, chain);
+                if (n == 0) {
+                        mb->rendered++;
+                        continue;
+                }
+
+                ret = max7219_send_latched(mb->frame.tr, n);
+                if (ret < 0) {
+                        printk(KERN_ALERT "MAX7219 frame failed %d\n", ret);
+                        // Not sure what the panel shows now.
+                        spin_lock_irq(&mb->lock);
+                        mb->stale = 1;
+                        spin_unlock_irq(&mb->lock);
+                        break;
+                }
+                memcpy(mb->shown, mb->frame.tx, sizeof(mb->shown));
+                mb->rows += hweight32(mask);
+                mb->rendered++;
+        }
 }
 
 /**
  * @brief send the pattern message to the MAX7219 through SPI bus.
- * @param *msg, the message array.
+ * @param *msg, the message array, 8 columns per chip of the chain, nearest first.
  * @param len, the length of the array.
  * @param cs_pin, the chip select pin for latching the data.
  * @return 0 on success, otherwise failed.
+ * @note the frame replaces any frame not rendered yet, only the newest one
+ * is sent, in the background.
  */
 int max7219_send_msg(uint8_t *msg, int length, int cs_pin) {
-        display_work_t *work;
-
-        work = (display_work_t *)kmalloc(sizeof(display_work_t), GFP_KERNEL);
-        if (!work)
-                return -ENOMEM;
-
-        INIT_WORK((struct work_struct *)work, max7219_work_function);
-        work->cs_pin = cs_pin;
-        memcpy(work->led, msg, length);
-        return queue_work(max7219_wq, (struct work_struct*)work);
+        display_mailbox_t *mb = &s_mailbox;
+
+        if (length < 0 || length > MAX_CHAIN * NUM_OF_COLUMNS)
+                return -EINVAL;
+
+        spin_lock_irq(&mb->lock);
+        if (mb->dirty)
+                mb->coalesced++;
+        // Chips not covered by the frame go blank.
+        memset(mb->pending, 0, sizeof(mb->pending));
+        memcpy(mb->pending, msg, length);
+        mb->dirty = 1;
+        mb->submitted++;
+        spin_unlock_irq(&mb->lock);
+
+        // Already queued or running, it will see the new frame.
+        queue_work(max7219_wq, &mb->work);
+        return 0;
 }
 
 /**
@@ -297,21 +491,32 @@ int max7219_send_msg(uint8_t *msg, int length, int cs_pin) {
  * @note we assume that every time a new chip select corresponding to a new
  * LED Matrix, so it needs to be initilized.
  * @param cs_pin, the chip select pin for latching the data.
+ * @param chain, the number of cascaded MAX7219s on the chip select.
+ * @return 0 on success, otherwise failed.
  */
-void max7219_device_config(int cs_pin) {
+int max7219_device_config(int cs_pin, unsigned int chain) {
         int cs_gpio;
-        int i;
-        cs_gpio = quark_gpio_shield_to_gpio(cs_pin);
 
-        for (i = 0; i < 4; ++i)
-        {
-                gpio_set_value_cansleep(cs_gpio, 0);
-                barrier();
-                max7219_send_one_msg(s_init_sequence[i][0], s_init_sequence[i][1]);
-                barrier();
-                gpio_set_value_cansleep(cs_gpio, 1);
-                mdelay(10);
-        }
+        if (chain < 1 || chain > MAX_CHAIN)
+                return -EINVAL;
+
+        cs_gpio = quark_gpio_shield_to_gpio(cs_pin);
+        if (cs_gpio < 0)
+                return -EINVAL;
+
+        // Idle high, every register is latched by a pulse from the work item.
+        mutex_lock(&spidev.latch_lock);
+        spidev.cs_gpio = cs_gpio;
+        gpio_set_value_cansleep(cs_gpio, 1);
+        mutex_unlock(&spidev.latch_lock);
+
+        // New panel, the next frame rewrites every row.
+        spin_lock_irq(&s_mailbox.lock);
+        s_mailbox.chain = chain;
+        s_mailbox.stale = 1;
+        spin_unlock_irq(&s_mailbox.lock);
+
+        return max7219_send_regs(s_init_sequence, NUM_OF_INIT, chain);
 }
 
 /**
@@ -322,51 +527,73 @@ int max7219_device_init(void) {
         int ret;
         struct spi_master *master;
 
+        // Avoid double init, before touching what the live device holds.
+        if (max7219_device != NULL)
+                return -EPERM;
+
         // Setup the GPIO multiplexing
         if (max7219_setup())
                 return -EFAULT;
 
         master = spi_busnum_to_master(max7219_info.bus_num);
-        if (!master)
-                return -ENODEV;
-
-        // Avoid double init.
-        if (max7219_device != NULL)
-                return -EPERM;
-
-        max7219_wq = create_workqueue("display_pattern");
-        if (!max7219_wq)
-                return -ENOMEM;
+        if (!master) {
+                ret = -ENODEV;
+                goto teardown;
+        }
 
         max7219_device = spi_new_device(master, &max7219_info);
         put_device(&master->dev);
         if (!max7219_device) {
-                destroy_workqueue(max7219_wq);
-                max7219_wq = NULL;
-                return -ENODEV;
+                ret = -ENODEV;
+                goto teardown;
         }
 
         max7219_device->bits_per_word = 8;
-        max7219_device->max_speed_hz = 1000000;
+        max7219_device->max_speed_hz = SPI_SPEED;
         //max7219_device->cs_gpio = 40;
 
         ret = spi_setup(max7219_device);
         if (ret)
-                spi_unregister_device(max7219_device);
-        else
-                printk(KERN_INFO "MAX7219 registered to SPI bus %u, chipselect %u\n", 
-                        max7219_info.bus_num, max7219_info.chip_select);
+                goto unregister;
+        printk(KERN_INFO "MAX7219 registered to SPI bus %u, chipselect %u\n", 
+                max7219_info.bus_num, max7219_info.chip_select);
 
         spin_lock_init(&spidev.spi_lock);
+        mutex_init(&spidev.latch_lock);
+        spidev.cs_gpio = -1;
         spidev.spi = max7219_device;
         spidev.speed_hz = max7219_device->max_speed_hz;
-        spidev.tx_buffer = kmalloc(BUFF_SIZE, GFP_KERNEL);
-        if (!spidev.tx_buffer) {
-                return -ENOMEM;
+        ret = spidev_request_init(&spidev);
+        if (ret)
+                goto free_request;
+
+        // Frames wait on the bus and the CS pulses, keep them off system_wq.
+        max7219_wq = alloc_ordered_workqueue("max7219", 0);
+        if (!max7219_wq) {
+                ret = -ENOMEM;
+                goto free_request;
         }
 
         spi_set_drvdata(max7219_device, &spidev);
 
+        // Preallocated mailbox, the display path allocates nothing per frame.
+        spin_lock_init(&s_mailbox.lock);
+        s_mailbox.dirty = 0;
+        s_mailbox.stale = 1;
+        s_mailbox.chain = 1;
+        s_mailbox.since_full = 0;
+        INIT_WORK(&s_mailbox.work, max7219_work_function);
+
+        return 0;
+
+free_request:
+        spidev.spi = NULL;
+        spidev_request_fini(&spidev);
+unregister:
+        spi_unregister_device(max7219_device);
+        max7219_device = NULL;
+teardown:
+        max7219_teardown();
         return ret;
 }
 
@@ -374,13 +601,20 @@ int max7219_device_init(void) {
  * @brief remove the device when module is removed
  */
 void max7219_device_exit(void) {
+        // No new frames, then let the one being rendered complete.
+        spin_lock_irq(&spidev.spi_lock);
+        spidev.spi = NULL;
+        spin_unlock_irq(&spidev.spi_lock);
+        cancel_work_sync(&s_mailbox.work);
+        destroy_workqueue(max7219_wq);
+        max7219_wq = NULL;
+        printk(KERN_INFO "MAX7219 frames submitted %lu, rendered %lu, coalesced %lu, rows %lu\n",
+               s_mailbox.submitted, s_mailbox.rendered, s_mailbox.coalesced, s_mailbox.rows);
+
         // Double free will be handled by spi_unregister_device, kfree, and gpio_free.
         spi_unregister_device(max7219_device);
-        destroy_workqueue(max7219_wq);
-        kfree(spidev.tx_buffer);
+        spidev_request_fini(&spidev);
         max7219_teardown();
         printk(KERN_ALERT "Goodbye, unregister the device\n");
-        spidev.tx_buffer = NULL;
         max7219_device = NULL;
-        max7219_wq = NULL;
 }
\ No newline at end of file
@@ -6,20 +6,26 @@
 #ifndef __MAX7219_H__
 #define __MAX7219_H__
 
+#define MAX_CHAIN       (8)                     /**< Most MAX7219s cascaded on one chip select */
+
 /**
  * @brief config the max7219 device with given chip select pin.
  * @note we assume that every time a new chip select corresponding to a new
  * LED Matrix, so it needs to be initilized.
  * @param cs_pin, the chip select pin for latching the data.
+ * @param chain, the number of cascaded MAX7219s on the chip select.
+ * @return 0 on success, otherwise failed.
  */
-void max7219_device_config(int);
+int max7219_device_config(int, unsigned int);
 
 /**
  * @brief send the pattern message to the MAX7219 through SPI bus.
- * @param *msg, the message array.
+ * @param *msg, the message array, 8 columns per chip of the chain, nearest first.
  * @param len, the length of the array.
  * @param cs_pin, the chip select pin for latching the data.
  * @return 0 on success, otherwise failed.
+ * @note the frame replaces any frame not rendered yet, only the newest one
+ * is sent, in the background.
  */
 int max7219_send_msg(uint8_t*, int, int);
 
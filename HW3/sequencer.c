@@ -0,0 +1,142 @@
+/**
+ * @file sequencer.c
+ * @brief Animation sequencer, plays uploaded frames on the MAX7219.
+ *
+ * The hrtimer expires at the end of each frame and hands over to the work
+ * item, which shows the next frame and arms the timer again. Expiries are
+ * absolute, one duration after the previous one, so the cadence does not
+ * drift with the work latency.
+ *
+ * @author Xiangyu Guo
+ */
+#include <linux/module.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+
+#include "common.h"
+#include "max7219.h"
+#include "sequencer.h"
+
+struct sequencer {
+        struct mutex lock;                      /**< Guards everything below */
+        genl_hb_sequence_t seq;                 /**< Sequence being played */
+        int cs_pin;                             /**< Chip select of the display */
+        unsigned int index;                     /**< Next frame to show */
+        unsigned int played;                    /**< Whole sequences played */
+        unsigned int rate;                      /**< Playback rate in percent */
+        int playing;                            /**< Timer and work may run */
+        ktime_t next;                           /**< Expiry of the frame on the display */
+        struct hrtimer timer;                   /**< Ends the frame on the display */
+        struct work_struct work;                /**< Shows the next frame */
+};
+
+static struct sequencer s_seq;                  /**< The only sequencer */
+
+/**
+ * @brief end of a frame, hand the next one to the work item.
+ * @param timer, the sequencer timer.
+ * @return HRTIMER_NORESTART, the work item arms it again.
+ */
+static enum hrtimer_restart sequencer_timer(struct hrtimer *timer) {
+        schedule_work(&s_seq.work);
+        return HRTIMER_NORESTART;
+}
+
+/**
+ * @brief show the next frame and arm the timer for its duration.
+ * @param work, the sequencer work.
+ */
+static void sequencer_work(struct work_struct *work) {
+        genl_hb_frame_t *frame;
+        unsigned int duration;
+
+        mutex_lock(&s_seq.lock);
+        if (!s_seq.playing) {
+                mutex_unlock(&s_seq.lock);
+                return;
+        }
+
+        frame = &s_seq.seq.frames[s_seq.index];
+        max7219_send_msg((uint8_t *)frame->pattern, sizeof(frame->pattern), s_seq.cs_pin);
+
+        duration = max(frame->duration * GENL_HB_RATE_NORMAL / s_seq.rate, 1U);
+        s_seq.next = ktime_add_ms(s_seq.next, duration);
+
+        if (++s_seq.index == s_seq.seq.count) {
+                s_seq.index = 0;
+                // The last frame stays on the display.
+                if (s_seq.seq.loops && ++s_seq.played == s_seq.seq.loops) {
+                        s_seq.playing = 0;
+                        mutex_unlock(&s_seq.lock);
+                        return;
+                }
+        }
+
+        hrtimer_start(&s_seq.timer, s_seq.next, HRTIMER_MODE_ABS);
+        mutex_unlock(&s_seq.lock);
+}
+
+/**
+ * @brief stop the playback and wait for the timer and the work item.
+ */
+static void sequencer_stop(void) {
+        mutex_lock(&s_seq.lock);
+        s_seq.playing = 0;
+        mutex_unlock(&s_seq.lock);
+
+        // Neither can start the other again once playing is clear.
+        hrtimer_cancel(&s_seq.timer);
+        cancel_work_sync(&s_seq.work);
+}
+
+void sequencer_init(void) {
+        mutex_init(&s_seq.lock);
+        s_seq.playing = 0;
+        s_seq.rate = GENL_HB_RATE_NORMAL;
+        hrtimer_init(&s_seq.timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+        s_seq.timer.function = sequencer_timer;
+        INIT_WORK(&s_seq.work, sequencer_work);
+}
+
+void sequencer_exit(void) {
+        sequencer_stop();
+}
+
+int sequencer_load(const genl_hb_sequence_t *seq, int cs_pin) {
+        unsigned int i;
+
+        if (seq->count > GENL_HB_MAX_FRAMES)
+                return -EINVAL;
+        for (i = 0; i < seq->count; ++i)
+                if (seq->frames[i].duration == 0)
+                        return -EINVAL;
+
+        sequencer_stop();
+        if (seq->count == 0)
+                return 0;
+
+        mutex_lock(&s_seq.lock);
+        s_seq.seq = *seq;
+        s_seq.cs_pin = cs_pin;
+        s_seq.index = 0;
+        s_seq.played = 0;
+        s_seq.next = ktime_get();
+        s_seq.playing = 1;
+        mutex_unlock(&s_seq.lock);
+
+        // First frame right away.
+        schedule_work(&s_seq.work);
+        return 0;
+}
+
+int sequencer_set_rate(unsigned int rate) {
+        if (rate < MIN_RATE || rate > MAX_RATE)
+                return -EINVAL;
+
+        mutex_lock(&s_seq.lock);
+        s_seq.rate = rate;
+        mutex_unlock(&s_seq.lock);
+        return 0;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file sequencer.h
+ * @brief Animation sequencer, plays uploaded frames on the MAX7219.
+ * @author Xiangyu Guo
+ */
+#ifndef __SEQUENCER_H__
+#define __SEQUENCER_H__
+
+#include "common.h"
+
+#define MIN_RATE        (10)                    /**< Slowest playback, percent of normal */
+#define MAX_RATE        (1000)                  /**< Fastest playback, percent of normal */
+
+/**
+ * @brief initialize the sequencer, nothing playing.
+ */
+void sequencer_init(void);
+
+/**
+ * @brief stop the playback, the current frame stays on the display.
+ */
+void sequencer_exit(void);
+
+/**
+ * @brief replace the sequence and play it from the first frame.
+ * @param seq, the sequence, count 0 only stops the playback.
+ * @param cs_pin, the chip select pin of the display.
+ * @return 0 on success, otherwise errno.
+ */
+int sequencer_load(const genl_hb_sequence_t *, int);
+
+/**
+ * @brief change the playback rate, from the next frame on.
+ * @param rate, percent of the uploaded durations, GENL_HB_RATE_NORMAL as is.
+ * @return 0 on success, otherwise errno.
+ */
+int sequencer_set_rate(unsigned int);
+
+#endif